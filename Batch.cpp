@@ -0,0 +1,864 @@
+#include "Batch.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Lanes of uint8_t processed by one SIMD instruction
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BATCH_SIMD_WIDTH 32
+typedef __m256i Lanes;
+
+static inline Lanes loadLanes(const uint8_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+static inline void storeLanes(uint8_t *p, Lanes v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+static inline Lanes splat(uint8_t value) { return _mm256_set1_epi8(static_cast<char>(value)); }
+static inline Lanes select(Lanes a, Lanes b, Lanes mask) { return _mm256_blendv_epi8(a, b, mask); }
+static inline Lanes add(Lanes a, Lanes b) { return _mm256_add_epi8(a, b); }
+static inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_epi8(a, b); }
+static inline Lanes subSaturate(Lanes a, Lanes b) { return _mm256_subs_epu8(a, b); }
+static inline Lanes bitOr(Lanes a, Lanes b) { return _mm256_or_si256(a, b); }
+static inline Lanes bitAnd(Lanes a, Lanes b) { return _mm256_and_si256(a, b); }
+static inline Lanes bitXor(Lanes a, Lanes b) { return _mm256_xor_si256(a, b); }
+static inline Lanes equal(Lanes a, Lanes b) { return _mm256_cmpeq_epi8(a, b); }
+static inline Lanes maximum(Lanes a, Lanes b) { return _mm256_max_epu8(a, b); }
+static inline Lanes shiftRight(Lanes a, int bits) { return _mm256_srli_epi16(a, bits); }
+static inline bool anyLane(Lanes mask) { return _mm256_movemask_epi8(mask) != 0; }
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BATCH_SIMD_WIDTH 16
+typedef __m128i Lanes;
+
+static inline Lanes loadLanes(const uint8_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+static inline void storeLanes(uint8_t *p, Lanes v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+static inline Lanes splat(uint8_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+static inline Lanes select(Lanes a, Lanes b, Lanes mask) { return _mm_or_si128(_mm_andnot_si128(mask, a), _mm_and_si128(mask, b)); }
+static inline Lanes add(Lanes a, Lanes b) { return _mm_add_epi8(a, b); }
+static inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_epi8(a, b); }
+static inline Lanes subSaturate(Lanes a, Lanes b) { return _mm_subs_epu8(a, b); }
+static inline Lanes bitOr(Lanes a, Lanes b) { return _mm_or_si128(a, b); }
+static inline Lanes bitAnd(Lanes a, Lanes b) { return _mm_and_si128(a, b); }
+static inline Lanes bitXor(Lanes a, Lanes b) { return _mm_xor_si128(a, b); }
+static inline Lanes equal(Lanes a, Lanes b) { return _mm_cmpeq_epi8(a, b); }
+static inline Lanes maximum(Lanes a, Lanes b) { return _mm_max_epu8(a, b); }
+static inline Lanes shiftRight(Lanes a, int bits) { return _mm_srli_epi16(a, bits); }
+static inline bool anyLane(Lanes mask) { return _mm_movemask_epi8(mask) != 0; }
+#else
+// No vector unit, every group runs lane by lane
+#define BATCH_SIMD_WIDTH 1
+#endif
+
+#if BATCH_SIMD_WIDTH > 1
+// Unsigned a > b, 0xFF or 0x00 per lane
+static inline Lanes greater(Lanes a, Lanes b) {
+	return bitXor(equal(maximum(a, b), b), splat(0xFF));
+}
+#endif
+
+Batch::Batch(size_t lanes) : lanes(lanes), stats() {
+	if (lanes == 0) {
+		throw std::runtime_error("Error: a batch needs at least one lane");
+	}
+	stride = (lanes + BATCH_SIMD_WIDTH - 1) / BATCH_SIMD_WIDTH * BATCH_SIMD_WIDTH;
+
+	V.assign(16 * stride, 0);
+	I.assign(stride, 0);
+	pc.assign(stride, 0);
+	opcode.assign(stride, 0);
+	sp.assign(stride, 0);
+	stack.assign(16 * stride, 0);
+	delayTimer.assign(stride, 0);
+	soundTimer.assign(stride, 0);
+	flags.assign(stride, 0);
+	faulted.assign(stride, 0);
+	active.assign(stride, 0);
+	keys.assign(16 * stride, 0);
+	display.assign(DISPLAY_HEIGHT * stride, 0);
+	dirtyRows.assign(stride, 0);
+	userFlags.assign(stride * 16, 0);
+	cycles.assign(stride, 0);
+	seed.assign(stride, 0);
+	rngState.assign(stride, 0);
+	memory.assign(stride, sharedMemory);
+	privateMemory.resize(stride);
+	mask.assign(stride, 0);
+
+	// Every lane starts as a freshly constructed machine
+	std::unique_ptr<Chip8> chip8(new Chip8());
+	std::unique_ptr<Snapshot> snapshot(new Snapshot());
+	chip8->saveState(*snapshot);
+	memcpy(sharedMemory, snapshot->memory, sizeof(sharedMemory));
+	for (size_t lane = 0; lane < lanes; lane++) {
+		loadState(lane, *snapshot);
+		dirtyRows[lane] = 0;
+	}
+}
+
+size_t Batch::getLanes(void) {
+	return lanes;
+}
+
+void Batch::loadROM(const char* fName) {
+	std::unique_ptr<Chip8> chip8(new Chip8());
+	chip8->loadROM(fName);
+
+	std::unique_ptr<Snapshot> snapshot(new Snapshot());
+	chip8->saveState(*snapshot);
+	memcpy(sharedMemory, snapshot->memory, sizeof(sharedMemory));
+	for (size_t lane = 0; lane < lanes; lane++) {
+		loadState(lane, *snapshot);
+		dirtyRows[lane] = 0;
+		cycles[lane] = 0;
+	}
+}
+
+void Batch::saveState(const size_t lane, Snapshot &snapshot) {
+	snapshot.version = SNAPSHOT_VERSION;
+	snapshot.opcode = opcode[lane];
+	snapshot.I = I[lane];
+	snapshot.pc = pc[lane];
+	memcpy(snapshot.stack, &stack[lane * 16], sizeof(snapshot.stack));
+	snapshot.sp = sp[lane];
+	snapshot.delayTimer = delayTimer[lane];
+	snapshot.soundTimer = soundTimer[lane];
+	snapshot.flags = flags[lane];
+	for (unsigned x = 0; x < 16; x++) {
+		snapshot.V[x] = V[x * stride + lane];
+	}
+	memcpy(snapshot.keys, &keys[lane * 16], sizeof(snapshot.keys));
+	snapshot.quirks = static_cast<uint8_t>(QuirkProfile::Legacy);
+	snapshot.reserved = 0;
+	snapshot.seed = seed[lane];
+	snapshot.rngState = rngState[lane];
+	memcpy(snapshot.userFlags, &userFlags[lane * 16], sizeof(snapshot.userFlags));
+	memset(snapshot.display, 0, sizeof(snapshot.display));
+	memcpy(snapshot.display, &display[lane * DISPLAY_HEIGHT], LowRes::words * sizeof(uint64_t));
+	memcpy(snapshot.memory, memory[lane], sizeof(snapshot.memory));
+}
+
+void Batch::loadState(const size_t lane, const Snapshot &snapshot) {
+	if (snapshot.version != SNAPSHOT_VERSION) {
+		throw std::runtime_error("Error: snapshot version");
+	}
+	if (snapshot.flags & SNAPSHOT_HIGH_RES) {
+		throw std::runtime_error("Error: the batch engine has no 128x64 mode");
+	}
+	if (snapshot.quirks != static_cast<uint8_t>(QuirkProfile::Legacy)) {
+		throw std::runtime_error("Error: the batch engine only runs the legacy quirk profile");
+	}
+	if (snapshot.sp < -1 || snapshot.sp > 15 || snapshot.pc > 4094) {
+		throw std::runtime_error("Error: snapshot registers out of range");
+	}
+
+	opcode[lane] = snapshot.opcode;
+	I[lane] = snapshot.I;
+	pc[lane] = snapshot.pc;
+	memcpy(&stack[lane * 16], snapshot.stack, sizeof(snapshot.stack));
+	sp[lane] = snapshot.sp;
+	delayTimer[lane] = snapshot.delayTimer;
+	soundTimer[lane] = snapshot.soundTimer;
+	flags[lane] = snapshot.flags;
+	faulted[lane] = 0;
+	active[lane] = snapshot.flags & SNAPSHOT_RUNNING ? 0xFF : 0;
+	for (unsigned x = 0; x < 16; x++) {
+		V[x * stride + lane] = snapshot.V[x];
+	}
+	memcpy(&keys[lane * 16], snapshot.keys, sizeof(snapshot.keys));
+	seed[lane] = snapshot.seed;
+	rngState[lane] = snapshot.rngState;
+	memcpy(&userFlags[lane * 16], snapshot.userFlags, sizeof(snapshot.userFlags));
+	memcpy(&display[lane * DISPLAY_HEIGHT], snapshot.display, LowRes::words * sizeof(uint64_t));
+	dirtyRows[lane] = allRows<LowRes>();
+
+	// Lanes whose memory matches the shared image keep sharing it
+	if (memcmp(snapshot.memory, sharedMemory, sizeof(sharedMemory)) == 0) {
+		memory[lane] = sharedMemory;
+		privateMemory[lane].reset();
+	}
+	else {
+		memcpy(writableMemory(lane), snapshot.memory, sizeof(snapshot.memory));
+	}
+}
+
+uint8_t* Batch::writableMemory(const size_t lane) {
+	if (!privateMemory[lane]) {
+		privateMemory[lane].reset(new uint8_t[4096]);
+		memcpy(privateMemory[lane].get(), memory[lane], 4096);
+		memory[lane] = privateMemory[lane].get();
+	}
+	return privateMemory[lane].get();
+}
+
+size_t Batch::step(void) {
+	pending.clear();
+	bool uniform = true;
+	// Neighbouring lanes usually fetch the same word of the shared image
+	const uint8_t *lastMemory = nullptr;
+	uint16_t lastPc = 0;
+	uint16_t lastOpcode = 0;
+	for (uint32_t lane = 0; lane < lanes; lane++) {
+		if (active[lane]) {
+			// The fetch reads two bytes, past the end a Chip8 object faults
+			if (pc[lane] > 4094) {
+				faulted[lane] = 1;
+				active[lane] = 0;
+				continue;
+			}
+			const uint8_t *mem = memory[lane];
+			if (mem != lastMemory || pc[lane] != lastPc) {
+				lastMemory = mem;
+				lastPc = pc[lane];
+				lastOpcode = mem[lastPc] << 8 | mem[lastPc + 1];
+				uniform &= pending.empty() || lastOpcode == opcode[pending[0]];
+			}
+			opcode[lane] = lastOpcode;
+			pending.push_back(lane);
+		}
+	}
+	size_t executed = pending.size();
+	if (executed == 0) {
+		return 0;
+	}
+	stats.steps++;
+
+	if (uniform) {
+		// All running lanes fetched the same opcode, they are masked by active
+		executeGroup(pending, opcode[pending[0]], active.data());
+		return executed;
+	}
+
+	while (!pending.empty()) {
+		const uint16_t groupOpcode = opcode[pending[0]];
+		group.clear();
+		rest.clear();
+		for (uint32_t lane : pending) {
+			(opcode[lane] == groupOpcode ? group : rest).push_back(lane);
+		}
+		executeGroup(group, groupOpcode, nullptr);
+		pending.swap(rest);
+	}
+	return executed;
+}
+
+void Batch::executeGroup(const std::vector<uint32_t> &members, const uint16_t opcode, const uint8_t *laneMask) {
+	const OpClass opClass = classifyOpCode(opcode);
+	stats.groups++;
+
+	// Below one lane per vector, lane by lane is cheaper
+	if (members.size() * BATCH_SIMD_WIDTH >= stride) {
+		if (!laneMask) {
+			for (uint32_t lane : members) {
+				mask[lane] = 0xFF;
+			}
+		}
+		bool masked = executeMasked(opClass, opcode, laneMask ? laneMask : mask.data());
+		if (!laneMask) {
+			for (uint32_t lane : members) {
+				mask[lane] = 0;
+			}
+		}
+		if (masked) {
+			stats.vectorGroups++;
+			return;
+		}
+	}
+
+	for (uint32_t lane : members) {
+		if (executeLane(lane, opClass, opcode)) {
+			cycles[lane]++;
+		}
+		else {
+			faulted[lane] = 1;
+			active[lane] = 0;
+		}
+	}
+}
+
+uint64_t Batch::run(const uint64_t cycles) {
+	uint64_t steps = 0;
+	while (steps < cycles && step() > 0) {
+		steps++;
+	}
+	return steps;
+}
+
+void Batch::tickTimers(void) {
+	size_t lane = 0;
+#if BATCH_SIMD_WIDTH > 1
+	for (; lane < stride; lane += BATCH_SIMD_WIDTH) {
+		storeLanes(&delayTimer[lane], subSaturate(loadLanes(&delayTimer[lane]), splat(1)));
+		storeLanes(&soundTimer[lane], subSaturate(loadLanes(&soundTimer[lane]), splat(1)));
+	}
+#endif
+	for (; lane < lanes; lane++) {
+		if (delayTimer[lane] > 0) {
+			delayTimer[lane]--;
+		}
+		if (soundTimer[lane] > 0) {
+			soundTimer[lane]--;
+		}
+	}
+}
+
+// Executes the lanes set in laneMask with one pass over the lane arrays.
+// Returns false for opcodes that have to run lane by lane.
+bool Batch::executeMasked(const OpClass opClass, const uint16_t opcode, const uint8_t *laneMask) {
+	const uint8_t *m = laneMask;
+	uint8_t *vx = &V[(opcode >> 8 & 0x0F) * stride];
+	uint8_t *vy = &V[(opcode >> 4 & 0x0F) * stride];
+	const uint8_t nn = opcode & 0x0FF;
+	const uint16_t nnn = opcode & 0x0FFF;
+
+	// Plain loops, the compiler vectorizes them over uint16_t lanes
+	switch (opClass) {
+		case OpClass::Jump: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				pc[lane] = m[lane] ? nnn : pc[lane];
+			}
+			break;
+		}
+		case OpClass::SkipEqImm: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				pc[lane] += m[lane] & (vx[lane] == nn ? 4 : 2);
+			}
+			break;
+		}
+		case OpClass::SkipNeImm: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				pc[lane] += m[lane] & (vx[lane] != nn ? 4 : 2);
+			}
+			break;
+		}
+		case OpClass::SkipEqReg: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				pc[lane] += m[lane] & (vx[lane] == vy[lane] ? 4 : 2);
+			}
+			break;
+		}
+		case OpClass::SkipNeReg: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				pc[lane] += m[lane] & (vx[lane] != vy[lane] ? 4 : 2);
+			}
+			break;
+		}
+		case OpClass::Call: {
+			// A lane that would fault runs the group lane by lane
+			for (size_t lane = 0; lane < stride; lane++) {
+				if (m[lane] && sp[lane] >= 15) {
+					return false;
+				}
+			}
+			for (size_t lane = 0; lane < stride; lane++) {
+				if (m[lane]) {
+					sp[lane]++;
+					stack[lane * 16 + sp[lane]] = pc[lane];
+					pc[lane] = nnn;
+				}
+			}
+			break;
+		}
+		case OpClass::Ret: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				if (m[lane] && sp[lane] < 0) {
+					return false;
+				}
+			}
+			for (size_t lane = 0; lane < stride; lane++) {
+				if (m[lane]) {
+					pc[lane] = stack[lane * 16 + sp[lane]] + 2;
+					sp[lane]--;
+				}
+			}
+			break;
+		}
+		case OpClass::GetDelay: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				vx[lane] = m[lane] ? delayTimer[lane] : vx[lane];
+				pc[lane] += m[lane] & 2;
+			}
+			break;
+		}
+		case OpClass::SetDelay: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				delayTimer[lane] = m[lane] ? vx[lane] : delayTimer[lane];
+				pc[lane] += m[lane] & 2;
+			}
+			break;
+		}
+		case OpClass::SetSound: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				soundTimer[lane] = m[lane] ? vx[lane] : soundTimer[lane];
+				pc[lane] += m[lane] & 2;
+			}
+			break;
+		}
+		case OpClass::LoadI: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				I[lane] = m[lane] ? nnn : I[lane];
+				pc[lane] += m[lane] & 2;
+			}
+			break;
+		}
+		case OpClass::Font: {
+			for (size_t lane = 0; lane < stride; lane++) {
+				I[lane] = m[lane] ? vx[lane] * 5 : I[lane];
+				pc[lane] += m[lane] & 2;
+			}
+			break;
+		}
+#if BATCH_SIMD_WIDTH > 1
+		case OpClass::LoadImm: case OpClass::AddImm: case OpClass::Move: case OpClass::Or:
+		case OpClass::And: case OpClass::Xor: case OpClass::AddReg: case OpClass::SubReg:
+		case OpClass::ShiftRight: case OpClass::SubNeg: case OpClass::ShiftLeft: {
+			executeRegisters(opClass, opcode, laneMask);
+			for (size_t lane = 0; lane < stride; lane++) {
+				pc[lane] += m[lane] & 2;
+			}
+			break;
+		}
+#endif
+		default: {
+			return false;
+		}
+	}
+
+	for (size_t lane = 0; lane < stride; lane++) {
+		cycles[lane] += m[lane] & 1;
+	}
+	return true;
+}
+
+#if BATCH_SIMD_WIDTH > 1
+// Register arithmetic of the lanes set in laneMask, BATCH_SIMD_WIDTH lanes at a time
+void Batch::executeRegisters(const OpClass opClass, const uint16_t opcode, const uint8_t *laneMask) {
+	uint8_t *vx = &V[(opcode >> 8 & 0x0F) * stride];
+	uint8_t *vy = &V[(opcode >> 4 & 0x0F) * stride];
+	uint8_t *vf = &V[0x0F * stride];
+	const Lanes nn = splat(opcode & 0x0FF);
+	const Lanes one = splat(1);
+
+	// Statements in the order of Chip8::decodeOpCode, VF may alias VX or VY
+	for (size_t lane = 0; lane < stride; lane += BATCH_SIMD_WIDTH) {
+		const Lanes m = loadLanes(&laneMask[lane]);
+		if (!anyLane(m)) {
+			continue;
+		}
+		uint8_t *x = vx + lane;
+		uint8_t *y = vy + lane;
+		uint8_t *f = vf + lane;
+
+		switch (opClass) {
+			case OpClass::LoadImm: {
+				storeLanes(x, select(loadLanes(x), nn, m));
+				break;
+			}
+			case OpClass::AddImm: {
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, add(a, nn), m));
+				break;
+			}
+			case OpClass::Move: {
+				storeLanes(x, select(loadLanes(x), loadLanes(y), m));
+				break;
+			}
+			case OpClass::Or: {
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, bitOr(a, loadLanes(y)), m));
+				break;
+			}
+			case OpClass::And: {
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, bitAnd(a, loadLanes(y)), m));
+				break;
+			}
+			case OpClass::Xor: {
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, bitXor(a, loadLanes(y)), m));
+				break;
+			}
+			case OpClass::AddReg: {
+				// Carry when VY > 0xFF - VX
+				Lanes carry = greater(loadLanes(y), bitXor(loadLanes(x), splat(0xFF)));
+				storeLanes(f, select(loadLanes(f), bitAnd(carry, one), m));
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, add(a, loadLanes(y)), m));
+				break;
+			}
+			case OpClass::SubReg: {
+				Lanes noBorrow = greater(loadLanes(x), loadLanes(y));
+				storeLanes(f, select(loadLanes(f), bitAnd(noBorrow, one), m));
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, sub(a, loadLanes(y)), m));
+				break;
+			}
+			case OpClass::ShiftRight: {
+				storeLanes(f, select(loadLanes(f), bitAnd(loadLanes(x), one), m));
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, bitAnd(shiftRight(a, 1), splat(0x7F)), m));
+				break;
+			}
+			case OpClass::SubNeg: {
+				Lanes noBorrow = greater(loadLanes(y), loadLanes(x));
+				storeLanes(f, select(loadLanes(f), bitAnd(noBorrow, one), m));
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, sub(loadLanes(y), a), m));
+				break;
+			}
+			case OpClass::ShiftLeft: {
+				storeLanes(f, select(loadLanes(f), bitAnd(shiftRight(loadLanes(x), 7), one), m));
+				Lanes a = loadLanes(x);
+				storeLanes(x, select(a, add(a, a), m));
+				break;
+			}
+			default: {
+				break;
+			}
+		}
+	}
+}
+#endif
+
+// Mirrors Chip8::decodeOpCode for one lane. Returns false where a Chip8
+// object faults, pc still on the instruction.
+bool Batch::executeLane(const uint32_t lane, const OpClass opClass, const uint16_t opcode) {
+	uint8_t &vx = V[(opcode >> 8 & 0x0F) * stride + lane];
+	uint8_t &vy = V[(opcode >> 4 & 0x0F) * stride + lane];
+	uint8_t &vf = V[0x0F * stride + lane];
+	uint16_t &p = pc[lane];
+	uint16_t &index = I[lane];
+	uint64_t *rows = &display[lane * DISPLAY_HEIGHT];
+	const uint8_t nn = opcode & 0x0FF;
+
+	switch (opClass) {
+		case OpClass::ScrollDown: {
+			scrollDown<LowRes>(rows, dirtyRows[lane], opcode & 0x0F);
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::Cls: {
+			clearDisplay<LowRes>(rows, dirtyRows[lane]);
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::ScrollRight: {
+			scrollRight<LowRes>(rows, dirtyRows[lane]);
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::ScrollLeft: {
+			scrollLeft<LowRes>(rows, dirtyRows[lane]);
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::Exit: {
+			flags[lane] = (flags[lane] | SNAPSHOT_EXITED) & ~SNAPSHOT_RUNNING;
+			active[lane] = 0;
+			break;
+		}
+		case OpClass::LowRes: {
+			// Already in 64x32, switching still blanks the screen
+			std::fill_n(rows, LowRes::words, 0);
+			dirtyRows[lane] = allRows<LowRes>();
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::Ret: {
+			if (sp[lane] < 0) {
+				return false;
+			}
+			p = stack[lane * 16 + sp[lane]];
+			sp[lane]--;
+			p += 2;
+			break;
+		}
+		case OpClass::Jump: {
+			p = opcode & 0x0FFF;
+			break;
+		}
+		case OpClass::Call: {
+			if (sp[lane] >= 15) {
+				return false;
+			}
+			sp[lane]++;
+			stack[lane * 16 + sp[lane]] = p;
+			p = opcode & 0x0FFF;
+			break;
+		}
+		case OpClass::SkipEqImm: {
+			p += vx == nn ? 4 : 2;
+			break;
+		}
+		case OpClass::SkipNeImm: {
+			p += vx != nn ? 4 : 2;
+			break;
+		}
+		case OpClass::SkipEqReg: {
+			p += vx == vy ? 4 : 2;
+			break;
+		}
+		case OpClass::LoadImm: {
+			vx = nn;
+			p += 2;
+			break;
+		}
+		case OpClass::AddImm: {
+			vx += nn;
+			p += 2;
+			break;
+		}
+		case OpClass::Move: {
+			vx = vy;
+			p += 2;
+			break;
+		}
+		case OpClass::Or: {
+			vx |= vy;
+			p += 2;
+			break;
+		}
+		case OpClass::And: {
+			vx &= vy;
+			p += 2;
+			break;
+		}
+		case OpClass::Xor: {
+			vx ^= vy;
+			p += 2;
+			break;
+		}
+		case OpClass::AddReg: {
+			vf = vy > 0xFF - vx ? 1 : 0;
+			vx += vy;
+			p += 2;
+			break;
+		}
+		case OpClass::SubReg: {
+			vf = vx > vy ? 1 : 0;
+			vx -= vy;
+			p += 2;
+			break;
+		}
+		case OpClass::ShiftRight: {
+			vf = vx & 0x01;
+			vx >>= 1;
+			p += 2;
+			break;
+		}
+		case OpClass::SubNeg: {
+			vf = vy > vx ? 1 : 0;
+			vx = vy - vx;
+			p += 2;
+			break;
+		}
+		case OpClass::ShiftLeft: {
+			vf = vx >> 7;
+			vx <<= 1;
+			p += 2;
+			break;
+		}
+		case OpClass::SkipNeReg: {
+			p += vx != vy ? 4 : 2;
+			break;
+		}
+		case OpClass::LoadI: {
+			index = opcode & 0x0FFF;
+			p += 2;
+			break;
+		}
+		case OpClass::JumpV0: {
+			p = (opcode & 0x0FFF) + V[lane];
+			break;
+		}
+		case OpClass::Random: {
+			vx = rngByte(rngState[lane]) & nn;
+			p += 2;
+			break;
+		}
+		case OpClass::Draw: {
+			if (index + (opcode & 0x0F) > 4096) {
+				return false;
+			}
+			uint8_t sprite[16];
+			for (unsigned line = 0; line < (opcode & 0x0Fu); line++) {
+				sprite[line] = memory[lane][index + line];
+			}
+			vf = blitSprite<LowRes>(rows, dirtyRows[lane], vx, vy, sprite, opcode & 0x0F) ? 1 : 0;
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::Draw16: {
+			if (index + 32 > 4096) {
+				return false;
+			}
+			uint8_t sprite[32];
+			for (unsigned i = 0; i < 32; i++) {
+				sprite[i] = memory[lane][index + i];
+			}
+			vf = blitSprite16<LowRes>(rows, dirtyRows[lane], vx, vy, sprite) ? 1 : 0;
+			p += 2;
+			flags[lane] |= SNAPSHOT_DRAW;
+			break;
+		}
+		case OpClass::SkipKey: {
+			if (vx > 0x0F) {
+				return false;
+			}
+			p += keys[lane * 16 + vx] ? 4 : 2;
+			break;
+		}
+		case OpClass::SkipNoKey: {
+			if (vx > 0x0F) {
+				return false;
+			}
+			p += !keys[lane * 16 + vx] ? 4 : 2;
+			break;
+		}
+		case OpClass::GetDelay: {
+			vx = delayTimer[lane];
+			p += 2;
+			break;
+		}
+		case OpClass::WaitKey: {
+			flags[lane] = (flags[lane] | SNAPSHOT_WAIT_FOR_KEY) & ~SNAPSHOT_RUNNING;
+			active[lane] = 0;
+			p += 2;
+			break;
+		}
+		case OpClass::SetDelay: {
+			delayTimer[lane] = vx;
+			p += 2;
+			break;
+		}
+		case OpClass::SetSound: {
+			soundTimer[lane] = vx;
+			p += 2;
+			break;
+		}
+		case OpClass::AddI: {
+			vf = index > 0xFFF - vx ? 1 : 0;
+			index += vx;
+			p += 2;
+			break;
+		}
+		case OpClass::Font: {
+			index = vx * 5;
+			p += 2;
+			break;
+		}
+		case OpClass::BigFont: {
+			index = BIG_FONT_ADDRESS + (vx & 0x0F) * 10;
+			p += 2;
+			break;
+		}
+		case OpClass::Bcd: {
+			if (index + 3 > 4096) {
+				return false;
+			}
+			uint8_t *mem = writableMemory(lane);
+			mem[index] = vx / 100;
+			mem[index + 1] = (vx / 10) % 10;
+			mem[index + 2] = vx % 10;
+			p += 2;
+			break;
+		}
+		case OpClass::Store: {
+			if (index + (opcode >> 8 & 0x0F) + 1 > 4096) {
+				return false;
+			}
+			uint8_t *mem = writableMemory(lane);
+			for (unsigned i = 0; i <= (opcode >> 8 & 0x0Fu); i++) {
+				mem[index + i] = V[i * stride + lane];
+			}
+			p += 2;
+			break;
+		}
+		case OpClass::Load: {
+			if (index + (opcode >> 8 & 0x0F) + 1 > 4096) {
+				return false;
+			}
+			const uint8_t *mem = memory[lane];
+			for (unsigned i = 0; i <= (opcode >> 8 & 0x0Fu); i++) {
+				V[i * stride + lane] = mem[index + i];
+			}
+			p += 2;
+			break;
+		}
+		case OpClass::SaveFlags: {
+			for (unsigned i = 0; i <= (opcode >> 8 & 0x0Fu); i++) {
+				userFlags[lane * 16 + i] = V[i * stride + lane];
+			}
+			p += 2;
+			break;
+		}
+		case OpClass::LoadFlags: {
+			for (unsigned i = 0; i <= (opcode >> 8 & 0x0Fu); i++) {
+				V[i * stride + lane] = userFlags[lane * 16 + i];
+			}
+			p += 2;
+			break;
+		}
+		default: {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Batch::keyPress(const size_t lane, const uint8_t key) {
+	if (flags[lane] & SNAPSHOT_WAIT_FOR_KEY) {
+		flags[lane] = (flags[lane] & ~SNAPSHOT_WAIT_FOR_KEY) | SNAPSHOT_RUNNING;
+		active[lane] = faulted[lane] ? 0 : 0xFF;
+
+		// Stores pressed key is VX cause of opcodes 0xEX9E and 0xEXA1
+		V[(opcode[lane] >> 8 & 0x0F) * stride + lane] = key;
+	}
+	keys[lane * 16 + (key & 0x0F)] = true;
+}
+
+void Batch::keyRelease(const size_t lane, const uint8_t key) {
+	keys[lane * 16 + (key & 0x0F)] = false;
+}
+
+bool Batch::isRunning(const size_t lane) {
+	return active[lane];
+}
+
+bool Batch::isWaitingForKey(const size_t lane) {
+	return flags[lane] & SNAPSHOT_WAIT_FOR_KEY;
+}
+
+bool Batch::isFaulted(const size_t lane) {
+	return faulted[lane];
+}
+
+void Batch::setSeed(const size_t lane, const uint64_t seed) {
+	this->seed[lane] = seed;
+	rngState[lane] = rngSeed(seed);
+}
+
+uint64_t Batch::getSeed(const size_t lane) {
+	return seed[lane];
+}
+
+uint64_t Batch::getCycles(const size_t lane) {
+	return cycles[lane];
+}
+
+const uint64_t (&Batch::getDisplay(const size_t lane))[DISPLAY_HEIGHT] {
+	return *reinterpret_cast<const uint64_t(*)[DISPLAY_HEIGHT]>(&display[lane * DISPLAY_HEIGHT]);
+}
+
+uint64_t Batch::takeDirtyRows(const size_t lane) {
+	uint64_t rows = dirtyRows[lane];
+	dirtyRows[lane] = 0;
+	return rows;
+}
+
+BatchStats Batch::getStats(void) {
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "chip8.hpp"
+
+// Counters of the lockstep scheduler
+struct BatchStats {
+	uint64_t steps;        // Lockstep cycles
+	uint64_t groups;       // Opcode groups executed
+	uint64_t vectorGroups; // Groups executed with SIMD lanes
+};
+
+// Runs many Chip8 machines in lockstep.
+// Registers, I, pc, sp and the timers of all lanes are kept as struct of
+// arrays, V[x] of every lane next to each other. Every step, the running
+// lanes are grouped by the opcode they fetched, which lanes at the same pc
+// of the same ROM share. Register arithmetic of a group is executed on all
+// lanes at once with SSE2/AVX2, lanes outside the group masked off;
+// everything else runs lane by lane.
+// Lanes share the memory image of the ROM until they write to it.
+// Every lane behaves exactly like its own Chip8 object, see saveState,
+// including its own CXNN generator and its faults, which stop the lane
+// with pc on the instruction. Only the 64x32 display mode exists: a lane
+// executing 00FF stops as faulted. Lanes run the Legacy quirk
+// profile.
+class Batch {
+private:
+	size_t lanes;
+	size_t stride; // Lane count rounded up to the SIMD width
+
+	std::vector<uint8_t> V; // V[x * stride + lane]
+	std::vector<uint16_t> I;
+	std::vector<uint16_t> pc;
+	std::vector<uint16_t> opcode;
+	std::vector<int8_t> sp;
+	std::vector<uint16_t> stack; // stack[lane * 16 + level]
+	std::vector<uint8_t> delayTimer;
+	std::vector<uint8_t> soundTimer;
+	std::vector<uint8_t> flags; // SNAPSHOT_* bits
+	std::vector<uint8_t> faulted; // Stopped where a Chip8 object would fault
+	std::vector<uint8_t> active; // 0xFF for running lanes, 0 for the others and the padding
+	std::vector<uint8_t> keys; // keys[lane * 16 + key]
+	std::vector<uint64_t> display; // display[lane * DISPLAY_HEIGHT + row]
+	std::vector<uint64_t> dirtyRows;
+	std::vector<uint8_t> userFlags; // userFlags[lane * 16 + x]
+	std::vector<uint64_t> cycles;
+	std::vector<uint64_t> seed;
+	std::vector<uint64_t> rngState;
+
+	// Lanes point to the shared image until their first write
+	uint8_t sharedMemory[4096];
+	std::vector<uint8_t*> memory;
+	std::vector<std::unique_ptr<uint8_t[]>> privateMemory;
+
+	// Scratch space of step
+	std::vector<uint32_t> pending;
+	std::vector<uint32_t> group;
+	std::vector<uint32_t> rest;
+	std::vector<uint8_t> mask;
+
+	BatchStats stats;
+
+	uint8_t* writableMemory(const size_t lane);
+	void executeGroup(const std::vector<uint32_t> &members, const uint16_t opcode, const uint8_t *laneMask);
+	bool executeMasked(const OpClass opClass, const uint16_t opcode, const uint8_t *laneMask);
+	void executeRegisters(const OpClass opClass, const uint16_t opcode, const uint8_t *laneMask);
+	bool executeLane(const uint32_t lane, const OpClass opClass, const uint16_t opcode);
+
+public:
+	Batch(size_t lanes);
+
+	size_t getLanes(void);
+
+	// Resets every lane to a freshly constructed Chip8 that loaded fName
+	void loadROM(const char* fName);
+	void saveState(const size_t lane, Snapshot &snapshot);
+	void loadState(const size_t lane, const Snapshot &snapshot);
+
+	// One instruction on every running lane, returns how many ran
+	size_t step(void);
+	uint64_t run(const uint64_t cycles);
+	void tickTimers(void);
+
+	void keyPress(const size_t lane, const uint8_t key);
+	void keyRelease(const size_t lane, const uint8_t key);
+	bool isRunning(const size_t lane);
+	bool isWaitingForKey(const size_t lane);
+	bool isFaulted(const size_t lane);
+	void setSeed(const size_t lane, const uint64_t seed);
+	uint64_t getSeed(const size_t lane);
+	uint64_t getCycles(const size_t lane);
+	const uint64_t (&getDisplay(const size_t lane))[DISPLAY_HEIGHT];
+	uint64_t takeDirtyRows(const size_t lane);
+	BatchStats getStats(void);
+};
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "Beeper.hpp"
+#include "Scheduler.hpp"
+
+// Rendered ahead of the first edge, so later edges arrive before their sample
+#define BEEPER_LATENCY (2 * BEEPER_CHUNK)
+// Edges further ahead than this tie guest time to the stream again
+#define BEEPER_MAX_AHEAD BEEPER_SAMPLE_RATE
+
+Beeper::Beeper(uint32_t instructionsPerSecond) : instructionsPerSecond(instructionsPerSecond),
+	samples(BEEPER_CHUNK), position(0), offset(0), synced(false), on(false), phase(0) {
+	initialize(1, BEEPER_SAMPLE_RATE);
+}
+
+Beeper::~Beeper() {
+	// The audio thread has to stop before the members go away
+	stop();
+}
+
+SoundQueue& Beeper::getQueue(void) {
+	return queue;
+}
+
+uint64_t Beeper::guestSample(const SoundEdge &edge) {
+	return edge.tick * BEEPER_SAMPLE_RATE / TIMER_HZ
+		+ static_cast<uint64_t>(edge.cycle) * BEEPER_SAMPLE_RATE / instructionsPerSecond;
+}
+
+bool Beeper::onGetData(Chunk &data) {
+	for (size_t i = 0; i < BEEPER_CHUNK; i++, position++) {
+		SoundEdge edge;
+		while (queue.peek(edge)) {
+			int64_t due = static_cast<int64_t>(guestSample(edge)) + offset;
+			if (!synced || due > static_cast<int64_t>(position + BEEPER_MAX_AHEAD)) {
+				due = static_cast<int64_t>(position + BEEPER_LATENCY);
+				offset = due - static_cast<int64_t>(guestSample(edge));
+				synced = true;
+			}
+			else if (due < static_cast<int64_t>(position)) {
+				// Late, the host fell behind: now
+				due = static_cast<int64_t>(position);
+				offset = due - static_cast<int64_t>(guestSample(edge));
+			}
+			if (due > static_cast<int64_t>(position)) {
+				break;
+			}
+			queue.pop(edge);
+			on = edge.on;
+		}
+
+		if (on) {
+			phase = (phase + BEEPER_FREQUENCY) % BEEPER_SAMPLE_RATE;
+			samples[i] = phase < BEEPER_SAMPLE_RATE / 2 ? BEEPER_AMPLITUDE : -BEEPER_AMPLITUDE;
+		}
+		else {
+			phase = 0;
+			samples[i] = 0;
+		}
+	}
+
+	data.samples = samples.data();
+	data.sampleCount = samples.size();
+	// Silence is streamed as well, the stream never ends
+	return true;
+}
+
+void Beeper::onSeek(sf::Time) {
+	// A live stream has nothing to seek
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <SFML/Audio.hpp>
+#include "chip8.hpp"
+
+#define BEEPER_SAMPLE_RATE 44100
+#define BEEPER_FREQUENCY 440
+#define BEEPER_AMPLITUDE 6000
+// Samples per onGetData call, about 12 ms
+#define BEEPER_CHUNK 512
+
+// Square wave buzzer driven by the sound edges of a Chip8, see SoundQueue.
+// SFML calls onGetData on its own audio thread, which drains the queue and
+// switches the tone at the very sample each edge maps to, so a beep lasts
+// exactly as long as the sound timer ran. Guest time is tied to the stream
+// by the first edge, a little ahead of what is being rendered; edges that
+// arrive too late or too far ahead (warp mode) tie it again.
+class Beeper : public sf::SoundStream {
+private:
+	SoundQueue queue;
+	uint32_t instructionsPerSecond;
+	std::vector<sf::Int16> samples;
+
+	// Audio thread only
+	uint64_t position; // Samples rendered so far
+	int64_t offset;    // Stream sample of guest sample 0
+	bool synced;
+	bool on;
+	uint32_t phase;
+
+	uint64_t guestSample(const SoundEdge &edge);
+	bool onGetData(Chunk &data) override;
+	void onSeek(sf::Time timeOffset) override;
+
+public:
+	Beeper(uint32_t instructionsPerSecond);
+	~Beeper();
+
+	// Pass to Chip8::setSoundQueue
+	SoundQueue& getQueue(void);
+};
\ No newline at end of file
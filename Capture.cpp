@@ -0,0 +1,223 @@
+#include "Capture.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "delta.hpp"
+
+// The baseline of keyframes
+static const uint64_t blankDisplay[DISPLAY_WORDS] = { };
+
+CaptureWriter::CaptureWriter(const std::string &path) : path(path), file(nullptr), frames(0),
+	pending(false), closing(false), failed(false) {
+	file = fopen(path.c_str(), "wb");
+	if (!file) {
+		throw std::runtime_error("Error: cannot create capture file " + path);
+	}
+	std::fill_n(previous, DISPLAY_WORDS, 0);
+	filling.reserve(CAPTURE_FLUSH_BYTES * 2);
+	draining.reserve(CAPTURE_FLUSH_BYTES * 2);
+
+	CaptureHeader header = CaptureHeader();
+	header.magic = CAPTURE_MAGIC;
+	header.version = CAPTURE_VERSION;
+	header.keyframeFrames = CAPTURE_KEYFRAME_FRAMES;
+	header.frameBytes = sizeof(previous);
+	const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&header);
+	filling.insert(filling.end(), bytes, bytes + sizeof(header));
+
+	thread = std::thread(&CaptureWriter::drain, this);
+}
+
+CaptureWriter::~CaptureWriter() {
+	try {
+		close();
+	}
+	catch (const std::runtime_error &) {
+		// The owner reports it when it calls close, a destructor cannot
+	}
+}
+
+void CaptureWriter::append(const uint64_t (&display)[DISPLAY_WORDS], const bool highRes) {
+	const bool keyframe = frames % CAPTURE_KEYFRAME_FRAMES == 0;
+	encodeDelta(reinterpret_cast<const uint8_t*>(keyframe ? blankDisplay : previous),
+		reinterpret_cast<const uint8_t*>(display), sizeof(previous), delta);
+	memcpy(previous, display, sizeof(previous));
+	frames++;
+
+	CaptureFrame record = CaptureFrame();
+	record.length = static_cast<uint32_t>(delta.size());
+	record.flags = (keyframe ? CAPTURE_KEYFRAME : 0) | (highRes ? CAPTURE_HIGH_RES : 0);
+	const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&record);
+	filling.insert(filling.end(), bytes, bytes + sizeof(record));
+	filling.insert(filling.end(), delta.begin(), delta.end());
+
+	if (filling.size() >= CAPTURE_FLUSH_BYTES) {
+		handOff(false);
+	}
+}
+
+void CaptureWriter::handOff(const bool wait) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (pending) {
+		if (!wait) {
+			// Still writing the last block, keep filling this one
+			return;
+		}
+		changed.wait(lock, [this] { return !pending; });
+	}
+	filling.swap(draining);
+	pending = true;
+	lock.unlock();
+	changed.notify_all();
+}
+
+void CaptureWriter::drain(void) {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [this] { return pending || closing; });
+		if (!pending) {
+			return;
+		}
+
+		// `draining` belongs to this thread until pending is cleared
+		lock.unlock();
+		if (!failed && fwrite(draining.data(), 1, draining.size(), file) != draining.size()) {
+			failed = true;
+		}
+		draining.clear();
+		lock.lock();
+		pending = false;
+		changed.notify_all();
+	}
+}
+
+void CaptureWriter::close(void) {
+	if (!file) {
+		return;
+	}
+
+	if (!filling.empty()) {
+		handOff(true);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	changed.notify_all();
+	thread.join();
+
+	bool complete = !failed && fflush(file) == 0;
+	complete = fclose(file) == 0 && complete;
+	file = nullptr;
+	if (!complete) {
+		throw std::runtime_error("Error: cannot write capture file " + path);
+	}
+}
+
+uint32_t CaptureWriter::getFrames(void) {
+	return frames;
+}
+
+const std::string& CaptureWriter::getPath(void) {
+	return path;
+}
+
+CaptureReader::CaptureReader(const std::string &path) : in(path, std::ios::binary), current(-1) {
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION
+		|| header.frameBytes != sizeof(display)) {
+		throw std::runtime_error("Error: " + path + " is not a capture file");
+	}
+	std::fill_n(display, DISPLAY_WORDS, 0);
+
+	// Only the frame headers are read, the deltas are skipped
+	uint64_t offset = sizeof(header);
+	CaptureFrame record;
+	while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+		offset += sizeof(record);
+		// The first frame is always a keyframe
+		if (index.empty() && !(record.flags & CAPTURE_KEYFRAME)) {
+			throw std::runtime_error("Error: " + path + " does not start with a keyframe");
+		}
+		if (!in.seekg(record.length, std::ios::cur)) {
+			break;
+		}
+		index.push_back({ offset, record.length, record.flags });
+		offset += record.length;
+	}
+
+	// Cut a frame the writer did not finish
+	in.clear();
+	in.seekg(0, std::ios::end);
+	while (!index.empty() && index.back().offset + index.back().length > static_cast<uint64_t>(in.tellg())) {
+		index.pop_back();
+	}
+}
+
+uint32_t CaptureReader::getFrames(void) {
+	return static_cast<uint32_t>(index.size());
+}
+
+uint32_t CaptureReader::getKeyframes(void) {
+	return static_cast<uint32_t>(std::count_if(index.begin(), index.end(),
+		[](const Entry &entry) { return entry.flags & CAPTURE_KEYFRAME; }));
+}
+
+uint64_t CaptureReader::getDeltaBytes(void) {
+	uint64_t bytes = 0;
+	for (auto &entry : index) {
+		bytes += entry.length;
+	}
+	return bytes;
+}
+
+void CaptureReader::decode(const uint32_t frame) {
+	const Entry &entry = index[frame];
+	// Nothing is decoded if this fails half way
+	current = -1;
+	delta.resize(entry.length);
+	in.clear();
+	in.seekg(static_cast<std::streamoff>(entry.offset));
+	if (!in.read(reinterpret_cast<char*>(delta.data()), entry.length)) {
+		throw std::runtime_error("Error: capture file is truncated");
+	}
+
+	if (entry.flags & CAPTURE_KEYFRAME) {
+		std::fill_n(display, DISPLAY_WORDS, 0);
+	}
+	if (!applyDelta(reinterpret_cast<uint8_t*>(display), sizeof(display), delta.data(), delta.size())) {
+		throw std::runtime_error("Error: corrupt delta in capture file");
+	}
+	current = frame;
+}
+
+void CaptureReader::seek(const uint32_t frame) {
+	if (frame >= index.size()) {
+		throw std::runtime_error("Error: frame " + std::to_string(frame) + " is past the end of the capture");
+	}
+
+	uint32_t keyframe = frame;
+	while (!(index[keyframe].flags & CAPTURE_KEYFRAME)) {
+		keyframe--;
+	}
+	if (current == frame) {
+		return;
+	}
+	// Going on from the decoded frame saves the keyframe
+	uint32_t next = current >= keyframe && current < frame ? static_cast<uint32_t>(current) + 1 : keyframe;
+	for (; next <= frame; next++) {
+		decode(next);
+	}
+}
+
+const uint64_t (&CaptureReader::getDisplay(void))[DISPLAY_WORDS] {
+	return display;
+}
+
+bool CaptureReader::isHighRes(void) {
+	return current >= 0 && (index[current].flags & CAPTURE_HIGH_RES);
+}
+
+uint64_t CaptureReader::getDisplayHash(void) {
+	return isHighRes() ? hashDisplay<HighRes>(display) : hashDisplay<LowRes>(display);
+}
\ No newline at end of file
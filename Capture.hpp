@@ -0,0 +1,115 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "display.hpp"
+
+#define CAPTURE_MAGIC 0x56384843 // "CH8V"
+#define CAPTURE_VERSION 1
+// Frames between two keyframes, the most a seek has to decode
+#define CAPTURE_KEYFRAME_FRAMES 60
+// Output handed to the writer thread at a time
+#define CAPTURE_FLUSH_BYTES (64 * 1024)
+
+// File header, followed by a CaptureFrame and its delta for every frame.
+// Nothing is written after the frames, so a capture can go to a pipe and
+// a truncated one is readable up to its last complete frame.
+struct CaptureHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t keyframeFrames;
+	uint32_t frameBytes; // Size of the display the deltas apply to
+	uint32_t reserved;
+};
+static_assert(sizeof(CaptureHeader) == 16, "CaptureHeader must be 16 bytes");
+
+#define CAPTURE_KEYFRAME 0x01 // The delta applies to a blank display
+#define CAPTURE_HIGH_RES 0x02
+
+// One frame: `length` bytes of encodeDelta output against the previous
+// frame, or against a blank display for keyframes
+struct CaptureFrame {
+	uint32_t length;
+	uint8_t flags; // CAPTURE_* bits above
+	uint8_t reserved[3];
+};
+static_assert(sizeof(CaptureFrame) == 8, "CaptureFrame must be 8 bytes");
+
+// Appends frames of the packed display to a file or pipe.
+// Encoding an unchanged frame costs a few word compares, a changed one
+// its XOR run-lengths; the bytes go to a background thread in
+// CAPTURE_FLUSH_BYTES blocks through two buffers, so append never waits
+// for the disk. If the disk falls behind, the buffer being filled grows.
+class CaptureWriter {
+private:
+	std::string path;
+	FILE *file;
+	uint64_t previous[DISPLAY_WORDS];
+	uint32_t frames;
+	std::vector<uint8_t> delta;
+
+	// Filled by append, written by the thread while `pending`
+	std::vector<uint8_t> filling;
+	std::vector<uint8_t> draining;
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool pending;
+	bool closing;
+	bool failed; // A write failed, reported by close
+	std::thread thread;
+
+	void handOff(const bool wait);
+	void drain(void);
+
+public:
+	CaptureWriter(const std::string &path);
+	~CaptureWriter();
+
+	CaptureWriter(const CaptureWriter&) = delete;
+	CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+	void append(const uint64_t (&display)[DISPLAY_WORDS], const bool highRes);
+	// Writes what is left and closes the file, throws if anything was lost
+	void close(void);
+	uint32_t getFrames(void);
+	const std::string& getPath(void);
+};
+
+// Random access to the frames of a capture file.
+// Opening reads the frame headers only; seek decodes forward from the
+// nearest keyframe, or from the current frame when that is closer.
+class CaptureReader {
+private:
+	struct Entry {
+		uint64_t offset; // Of the delta
+		uint32_t length;
+		uint8_t flags;
+	};
+
+	std::ifstream in;
+	CaptureHeader header;
+	std::vector<Entry> index;
+	std::vector<uint8_t> delta;
+	uint64_t display[DISPLAY_WORDS];
+	int64_t current; // Decoded frame, -1 before the first seek
+
+	void decode(const uint32_t frame);
+
+public:
+	CaptureReader(const std::string &path);
+
+	uint32_t getFrames(void);
+	uint32_t getKeyframes(void);
+	uint64_t getDeltaBytes(void);
+	// Throws for frames past the end and for corrupt deltas
+	void seek(const uint32_t frame);
+	const uint64_t (&getDisplay(void))[DISPLAY_WORDS];
+	bool isHighRes(void);
+	// Chip8::getDisplayHash of the frame
+	uint64_t getDisplayHash(void);
+};
\ No newline at end of file
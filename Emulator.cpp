@@ -0,0 +1,263 @@
+#include "Emulator.hpp"
+#include <cstring>
+#include <iomanip>
+#include <utility>
+
+Emulator::Emulator(Chip8 &chip8, uint32_t instructionsPerSecond, ClockMode mode, Movie *movie)
+	: chip8(chip8), scheduler(chip8, instructionsPerSecond, mode), movie(movie), rewinding(false),
+	carriedRows(0), carriedLatency(), presses(), lastTag(0), stopping(false), failed(false),
+	stats(), published(0), skipped(0), keyWaitSince(0)
+{ }
+
+Emulator::~Emulator() {
+	stop();
+}
+
+void Emulator::start(void) {
+	stopping.store(false);
+	thread = std::thread(&Emulator::run, this);
+}
+
+void Emulator::stop(void) {
+	if (thread.joinable()) {
+		stopping.store(true);
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+		}
+		wake.notify_one();
+		thread.join();
+	}
+}
+
+bool Emulator::post(const InputEvent &event) {
+	if (!input.push(event)) {
+		return false;
+	}
+	// Taking the mutex orders the push before a sleeper's last look at the queue
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wake.notify_one();
+	return true;
+}
+
+const Frame* Emulator::takeFrame(void) {
+	return frames.update() ? &frames.getFront() : nullptr;
+}
+
+bool Emulator::hasFailed(void) {
+	return failed.load(std::memory_order_acquire);
+}
+
+OpCodeException* Emulator::getFault(void) {
+	return hasFailed() ? fault.get() : nullptr;
+}
+
+uint64_t Emulator::getPresses(void) {
+	return lastTag;
+}
+
+EmulatorStats Emulator::takeStats(void) {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	EmulatorStats taken = stats;
+	stats.emulate.reset();
+	// A wait that is still going on counts up to now
+	if (keyWaitSince) {
+		taken.keyWaitNs += steadyNs() - keyWaitSince;
+	}
+	return taken;
+}
+
+void Emulator::run(void) {
+	while (!stopping.load(std::memory_order_relaxed)) {
+		InputEvent event;
+		while (input.pop(event)) {
+			handle(event);
+		}
+		if (isIdle()) {
+			waitForInput();
+			continue;
+		}
+
+		const uint64_t started = steadyNs();
+		try {
+			if (rewinding) {
+				// Walk back one tick of history instead of running one
+				rewind.step(chip8);
+				chip8.setDrawFlag(true);
+			}
+			else {
+				uint64_t frame = scheduler.getFrameCount();
+				scheduler.runFrame();
+				rewind.push(chip8);
+				if (movie && scheduler.getFrameCount() != frame) {
+					movie->recordFrame(scheduler.getFrameCount(), chip8.getDisplayHash());
+				}
+			}
+		}
+		catch (OpCodeException &e) {
+			fault.reset(new OpCodeException(e));
+			failed.store(true, std::memory_order_release);
+			return;
+		}
+
+		if (chip8.getDrawFlag()) {
+			chip8.setDrawFlag(false);
+			publishFrame();
+		}
+
+		// One uncontended lock per tick
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			stats.machine = chip8.getMetrics();
+			stats.framesPublished = published;
+			stats.framesSkipped = skipped;
+			stats.emulate.record(steadyNs() - started);
+		}
+
+		// Sleeps until the next tick is due, returns at once in warp mode
+		scheduler.waitForNextFrame();
+	}
+}
+
+bool Emulator::isIdle(void) {
+	// Waiting in FX0A or stopped by 00FD, with both timers at zero, every
+	// further tick would be identical. Ticks are not counted while asleep,
+	// which a movie replays the same way.
+	return !rewinding && (chip8.isWaitingForKey() || chip8.hasExited())
+		&& chip8.delayTimer == 0 && chip8.soundTimer == 0;
+}
+
+void Emulator::waitForInput(void) {
+	const bool waitingForKey = chip8.isWaitingForKey();
+	if (waitingForKey) {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		keyWaitSince = steadyNs();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wake.wait(lock, [this] {
+			InputEvent event;
+			return stopping.load() || input.peek(event);
+		});
+	}
+
+	if (waitingForKey) {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.keyWaitNs += steadyNs() - keyWaitSince;
+		keyWaitSince = 0;
+	}
+}
+
+void Emulator::handle(const InputEvent &event) {
+	switch (event.kind) {
+		case InputKind::KeyDown:
+		case InputKind::KeyUp: {
+			const bool pressed = event.kind == InputKind::KeyDown;
+			// Applied here, the movie gets the exact tick and instruction
+			if (movie) {
+				movie->recordKey(scheduler.getFrameCount(), chip8.getCycles(), event.key, pressed);
+			}
+			if (pressed) {
+				// Tag 0 means untagged, it is never handed out
+				const uint32_t tag = ++lastTag;
+				presses[tag % EMULATOR_PRESSES] = { tag, event.earliest, event.polled, steadyNs() };
+				chip8.keyPress(event.key, tag);
+			}
+			else {
+				chip8.keyRelease(event.key);
+			}
+			break;
+		}
+		case InputKind::RewindStart: {
+			// A movie only holds keys, it cannot jump back in time
+			rewinding = !movie;
+			break;
+		}
+		case InputKind::RewindStop: {
+			rewinding = false;
+			break;
+		}
+		case InputKind::QuickSave: {
+			if (!quickSave) {
+				quickSave.reset(new Snapshot());
+			}
+			chip8.saveState(*quickSave);
+			break;
+		}
+		case InputKind::QuickLoad: {
+			if (quickSave && !movie) {
+				chip8.loadState(*quickSave);
+				chip8.setDrawFlag(true);
+				rewind.clear();
+			}
+			break;
+		}
+	}
+}
+
+void Emulator::publishFrame(void) {
+	Frame &frame = frames.getBack();
+	memcpy(frame.display, chip8.getDisplay(), sizeof(frame.display));
+	frame.dirtyRows = chip8.takeDirtyRows() | carriedRows;
+	frame.highRes = chip8.isHighRes();
+
+	frame.latency = carriedLatency;
+	const uint32_t tag = chip8.takeInputTag();
+	const Press &press = presses[tag % EMULATOR_PRESSES];
+	// A skipped frame responded first, otherwise a press that is still known
+	if (!frame.latency.polled && tag && press.tag == tag) {
+		frame.latency = { press.earliest, press.polled, press.applied, steadyNs() };
+	}
+
+	// The rows of a frame that was never taken still have to reach the
+	// screen, and its response is only seen with this one
+	published++;
+	if (frames.publish()) {
+		skipped++;
+		carriedRows = frames.getBack().dirtyRows;
+		carriedLatency = frames.getBack().latency;
+	}
+	else {
+		carriedRows = 0;
+		carriedLatency = InputLatency();
+	}
+}
+
+void LatencyStats::record(const InputLatency &latency, const uint64_t presented) {
+	window.record(latency.polled - latency.earliest);
+	queue.record(latency.applied - latency.polled);
+	emulate.record(latency.published - latency.applied);
+	present.record(presented - latency.published);
+	total.record(presented - latency.polled);
+}
+
+void LatencyStats::write(std::ostream &out, const ProfileFormat format, const char *rom, const uint64_t presses) {
+	const std::pair<const char*, const Histogram*> stages[] = {
+		{ "window", &window }, { "queue", &queue }, { "emulate", &emulate },
+		{ "present", &present }, { "total", &total }
+	};
+
+	if (format == ProfileFormat::Json) {
+		out << "{\"rom\": \"";
+		for (const char *c = rom; *c; c++) {
+			out << (*c == '"' || *c == '\\' ? "\\" : "") << *c;
+		}
+		out << "\", \"presses\": " << presses
+			<< ", \"responses\": " << total.getCount();
+		for (const auto &stage : stages) {
+			out << ", \"" << stage.first << "_ns\": ";
+			stage.second->writeJson(out);
+		}
+		out << "}" << std::endl;
+	}
+	else if (format == ProfileFormat::Text) {
+		out << "input latency of " << rom << ": " << presses << " presses, "
+			<< total.getCount() << " with a visible response" << std::endl;
+		for (const auto &stage : stages) {
+			out << std::setw(8) << std::left << stage.first << std::right;
+			stage.second->writeText(out, 1000, "us");
+		}
+	}
+}
\ No newline at end of file
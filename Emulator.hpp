@@ -0,0 +1,170 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include "chip8.hpp"
+#include "Histogram.hpp"
+#include "Movie.hpp"
+#include "OpcodeException.hpp"
+#include "Profiler.hpp"
+#include "Rewind.hpp"
+#include "Scheduler.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+
+// Input from the window thread to the emulation thread
+enum class InputKind : uint8_t {
+	KeyDown,     // Keypad key `key`
+	KeyUp,
+	RewindStart, // One tick of history per tick until RewindStop
+	RewindStop,
+	QuickSave,
+	QuickLoad
+};
+
+struct InputEvent {
+	InputKind kind;
+	uint8_t key;
+	// Steady clock ns, see steadyNs. The event reached the OS queue after
+	// `earliest`, when the window thread last found it empty, and was taken
+	// out of it at `polled`.
+	uint64_t earliest;
+	uint64_t polled;
+};
+
+typedef SpscQueue<InputEvent, 256> InputQueue;
+
+inline uint64_t steadyNs(void) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Path of a key press to the first frame that responds to it, see
+// Chip8::takeInputTag. Steady clock ns, all zero for frames that respond
+// to no press.
+struct InputLatency {
+	uint64_t earliest;
+	uint64_t polled;
+	uint64_t applied;   // Emulation thread pressed the key
+	uint64_t published; // Frame handed to the window thread
+};
+
+// A finished screen, handed from the emulation thread to the window thread
+struct Frame {
+	uint64_t display[DISPLAY_WORDS];
+	uint64_t dirtyRows; // Since the last frame the window thread took
+	bool highRes;
+	InputLatency latency;
+};
+
+// Input latency histograms of one session, fed by the window thread once a
+// frame that responds to a press is on screen. Split where the press
+// changes hands: the OS queue (an upper bound, the window thread cannot
+// see the event arrive while it presents), the input queue, the guest and
+// the present.
+class LatencyStats {
+private:
+	Histogram window;
+	Histogram queue;
+	Histogram emulate;
+	Histogram present;
+	Histogram total; // Polled to presented
+
+public:
+	void record(const InputLatency &latency, const uint64_t presented);
+	// `presses` tagged in total, the rest never got a visible response
+	void write(std::ostream &out, const ProfileFormat format, const char *rom, const uint64_t presses);
+};
+
+// Presses followed at once, older ones are given up
+#define EMULATOR_PRESSES 64
+
+// Live counters of a session, see Emulator::takeStats
+struct EmulatorStats {
+	Metrics machine;          // As of the last tick
+	uint64_t framesPublished; // Handed to the window thread
+	uint64_t framesSkipped;   // Replaced by a newer one before the window thread took them
+	uint64_t keyWaitNs;       // Asleep in FX0A, where no ticks are counted
+	Histogram emulate;        // ns per tick on the emulation thread, since the last takeStats
+};
+
+// Runs a Chip8 in 60 Hz ticks on its own thread.
+// The window thread posts input through a lock-free queue and takes the
+// newest frame from a triple buffer, so neither ever waits for the other:
+// a slow present skips frames instead of slowing the guest down.
+// Rewinding, quick saves and movie recording happen on the emulation
+// thread between ticks, where the machine is consistent. A guest that can
+// only be woken by a key blocks the thread until input arrives.
+class Emulator {
+private:
+	Chip8 &chip8;
+	Scheduler scheduler;
+	Rewind rewind;
+	Movie *movie; // Recording, or nullptr
+	std::unique_ptr<Snapshot> quickSave;
+	bool rewinding;
+
+	InputQueue input;
+	TripleBuffer<Frame> frames;
+	uint64_t carriedRows; // Dirty rows of frames the window thread skipped
+	InputLatency carriedLatency;
+
+	// Presses in flight, by tag modulo EMULATOR_PRESSES
+	struct Press {
+		uint32_t tag;
+		uint64_t earliest;
+		uint64_t polled;
+		uint64_t applied;
+	};
+	Press presses[EMULATOR_PRESSES];
+	uint32_t lastTag;
+
+	std::thread thread;
+	// Wakes the emulation thread when it sleeps in waitForInput
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	std::atomic<bool> stopping;
+	std::atomic<bool> failed;
+	std::unique_ptr<OpCodeException> fault; // Written before failed is set
+
+	// Updated once per tick, taken by the window thread
+	std::mutex statsMutex;
+	EmulatorStats stats;
+	uint64_t published; // Emulation thread copies of the frame counters
+	uint64_t skipped;
+	uint64_t keyWaitSince; // steadyNs the thread fell asleep in FX0A, 0 while awake
+
+	void run(void);
+	bool isIdle(void);
+	void waitForInput(void);
+	void handle(const InputEvent &event);
+	void publishFrame(void);
+
+public:
+	Emulator(Chip8 &chip8, uint32_t instructionsPerSecond, ClockMode mode, Movie *movie);
+	~Emulator();
+
+	Emulator(const Emulator&) = delete;
+	Emulator& operator=(const Emulator&) = delete;
+
+	// The machine belongs to the emulation thread until stop returns
+	void start(void);
+	void stop(void);
+
+	// Window thread. Returns false if the queue is full and the event was dropped.
+	bool post(const InputEvent &event);
+	// The newest frame, nullptr if none was published since the last call
+	const Frame* takeFrame(void);
+	// The emulation thread stopped on an invalid opcode, see getFault
+	bool hasFailed(void);
+	OpCodeException* getFault(void);
+	// Key presses followed for their latency, read after stop
+	uint64_t getPresses(void);
+	// Window thread, any time. Starts a new emulate histogram.
+	EmulatorStats takeStats(void);
+};
\ No newline at end of file
@@ -0,0 +1,824 @@
+#include "GdbStub.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A closed client must not kill the emulator with SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define GDB_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define GDB_SEND_FLAGS 0
+#endif
+
+// Signal numbers of stop replies, as GDB numbers them
+#define GDB_SIGINT 2
+#define GDB_SIGILL 4
+#define GDB_SIGTRAP 5
+#define GDB_SIGSEGV 11
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static void appendHex(std::string &out, const uint8_t byte) {
+	out += hexDigits[byte >> 4];
+	out += hexDigits[byte & 0x0F];
+}
+
+static int hexValue(const int c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static bool decodeHex(const std::string &hex, std::vector<uint8_t> &bytes) {
+	if (hex.size() % 2) {
+		return false;
+	}
+	bytes.clear();
+	for (size_t i = 0; i < hex.size(); i += 2) {
+		int high = hexValue(hex[i]), low = hexValue(hex[i + 1]);
+		if (high < 0 || low < 0) {
+			return false;
+		}
+		bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+	}
+	return true;
+}
+
+static std::string encodeHex(const std::string &text) {
+	std::string hex;
+	for (char c : text) {
+		appendHex(hex, static_cast<uint8_t>(c));
+	}
+	return hex;
+}
+
+// Parses "addr,length" of m, M and Z packets, the rest is left in `end`
+static bool parseRange(const char *text, unsigned long &address, unsigned long &length, const char *&end) {
+	char *next;
+	address = strtoul(text, &next, 16);
+	if (next == text || *next != ',') {
+		return false;
+	}
+	text = next + 1;
+	length = strtoul(text, &next, 16);
+	end = next;
+	return next != text;
+}
+
+static std::string signalReply(const int signal) {
+	std::string reply = "S";
+	appendHex(reply, static_cast<uint8_t>(signal));
+	return reply;
+}
+
+GdbStub::GdbStub(Chip8 &chip8, const uint16_t port) : chip8(chip8), port(port), listener(-1), connection(-1),
+	noAck(false), inputStart(0), inputEnd(0), stopped(true), replyPending(false), stopReply(signalReply(GDB_SIGTRAP)),
+	stepping(false), resuming(false) {
+	std::fill_n(breakpoints, 4096, false);
+	std::fill_n(conditional, 4096, false);
+	std::fill_n(watchpoints, 4096, 0);
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0) {
+		throw std::runtime_error("Error: cannot create the debugger socket");
+	}
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	// The client can rewrite the guest at will, only local ones are accepted
+	sockaddr_in address = sockaddr_in();
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 1) < 0
+		|| getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+		close(listener);
+		throw std::runtime_error("Error: cannot listen for a debugger on port " + std::to_string(port));
+	}
+	this->port = ntohs(address.sin_port);
+}
+
+GdbStub::~GdbStub() {
+	disconnect();
+	if (listener >= 0) {
+		close(listener);
+	}
+}
+
+uint16_t GdbStub::getPort(void) {
+	return port;
+}
+
+void GdbStub::accept(void) {
+	std::cerr << "Waiting for a debugger on 127.0.0.1:" << port << std::endl;
+	connection = ::accept(listener, nullptr, nullptr);
+	if (connection < 0) {
+		throw std::runtime_error("Error: cannot accept a debugger connection");
+	}
+	// One client per session
+	close(listener);
+	listener = -1;
+
+	// Packets are small and answered one by one
+	int noDelay = 1;
+	setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+}
+
+void GdbStub::disconnect(void) {
+	if (connection >= 0) {
+		close(connection);
+		connection = -1;
+	}
+}
+
+int GdbStub::readByte(const bool wait) {
+	if (inputStart == inputEnd) {
+		if (connection < 0) {
+			return -1;
+		}
+		ssize_t received = recv(connection, input, sizeof(input), wait ? 0 : MSG_DONTWAIT);
+		if (received < 0 && !wait && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return -2;
+		}
+		if (received <= 0) {
+			disconnect();
+			return -1;
+		}
+		inputStart = 0;
+		inputEnd = static_cast<size_t>(received);
+	}
+	return static_cast<uint8_t>(input[inputStart++]);
+}
+
+bool GdbStub::sendPacket(const std::string &payload) {
+	std::string packet = "$" + payload + "#";
+	uint8_t checksum = 0;
+	for (char c : payload) {
+		checksum += static_cast<uint8_t>(c);
+	}
+	appendHex(packet, checksum);
+
+	while (connection >= 0) {
+		size_t sent = 0;
+		while (sent < packet.size()) {
+			ssize_t written = send(connection, packet.data() + sent, packet.size() - sent, GDB_SEND_FLAGS);
+			if (written <= 0) {
+				disconnect();
+				return false;
+			}
+			sent += static_cast<size_t>(written);
+		}
+		if (noAck) {
+			return true;
+		}
+
+		// '-' asks for the packet again
+		int c;
+		while ((c = readByte(true)) != '+' && c != '-') {
+			if (c < 0) {
+				return false;
+			}
+		}
+		if (c == '+') {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool GdbStub::receivePacket(std::string &payload) {
+	while (true) {
+		// Acks, and interrupts sent while already stopped, come before the packet
+		int c;
+		while ((c = readByte(true)) != '$') {
+			if (c < 0) {
+				return false;
+			}
+		}
+
+		payload.clear();
+		uint8_t checksum = 0;
+		while ((c = readByte(true)) != '#') {
+			if (c < 0) {
+				return false;
+			}
+			payload += static_cast<char>(c);
+			checksum += static_cast<uint8_t>(c);
+		}
+		int high = readByte(true);
+		int low = readByte(true);
+		if (high < 0 || low < 0) {
+			return false;
+		}
+
+		bool valid = hexValue(high) >= 0 && hexValue(low) >= 0 && (hexValue(high) << 4 | hexValue(low)) == checksum;
+		if (!noAck && send(connection, valid ? "+" : "-", 1, GDB_SEND_FLAGS) != 1) {
+			disconnect();
+			return false;
+		}
+		if (valid) {
+			return true;
+		}
+	}
+}
+
+void GdbStub::poll(void) {
+	while (!stopped) {
+		int c = readByte(false);
+		if (c == -2) {
+			return;
+		}
+		if (c < 0) {
+			// Gone without detaching, serve kills the guest
+			stopped = true;
+			return;
+		}
+		// Ctrl-C in the client
+		if (c == 0x03) {
+			stop(signalReply(GDB_SIGINT));
+		}
+	}
+}
+
+bool GdbStub::isStopped(void) {
+	return stopped;
+}
+
+void GdbStub::stop(const std::string &reply) {
+	stopped = true;
+	replyPending = true;
+	stopReply = reply;
+	stepping = false;
+}
+
+bool GdbStub::resume(const std::string &packet) {
+	// c [addr], s [addr], C sig[;addr], S sig[;addr] or vCont;action[:thread]...
+	char action = packet[0];
+	const char *address = packet.c_str() + 1;
+	if (packet.compare(0, 6, "vCont;") == 0) {
+		action = packet[6];
+		address = "";
+	}
+	else if (action == 'C' || action == 'S') {
+		// The signal is not delivered anywhere, a guest has no handlers
+		const char *separator = strchr(address, ';');
+		address = separator ? separator + 1 : "";
+	}
+
+	if (*address) {
+		unsigned long pc = strtoul(address, nullptr, 16);
+		if (pc > 4094) {
+			return false;
+		}
+		chip8.pc = static_cast<uint16_t>(pc);
+	}
+	if (action != 'c' && action != 'C' && action != 's' && action != 'S') {
+		return false;
+	}
+
+	stopped = false;
+	stepping = action == 's' || action == 'S';
+	resuming = true;
+	return true;
+}
+
+DebugAction GdbStub::serve(void) {
+	if (connection < 0) {
+		return DebugAction::Kill;
+	}
+	if (replyPending) {
+		replyPending = false;
+		if (!console.empty() && !sendPacket("O" + encodeHex(console))) {
+			return DebugAction::Kill;
+		}
+		console.clear();
+		if (!sendPacket(stopReply)) {
+			return DebugAction::Kill;
+		}
+	}
+
+	std::string packet;
+	while (receivePacket(packet)) {
+		if (packet.empty()) {
+			sendPacket("");
+			continue;
+		}
+
+		switch (packet[0]) {
+			case 'c':
+			case 'C':
+			case 's':
+			case 'S':
+				if (resume(packet)) {
+					return DebugAction::Resume;
+				}
+				sendPacket("E01");
+				continue;
+			case 'D':
+				sendPacket("OK");
+				disconnect();
+				stopped = false;
+				return DebugAction::Detach;
+			case 'k':
+				disconnect();
+				return DebugAction::Kill;
+		}
+		if (packet.compare(0, 6, "vCont;") == 0) {
+			if (resume(packet)) {
+				return DebugAction::Resume;
+			}
+			sendPacket("E01");
+			continue;
+		}
+		if (packet.compare(0, 5, "vKill") == 0) {
+			sendPacket("OK");
+			disconnect();
+			return DebugAction::Kill;
+		}
+
+		if (!sendPacket(handle(packet))) {
+			break;
+		}
+		// Acks stop after the OK
+		if (packet == "QStartNoAckMode") {
+			noAck = true;
+		}
+	}
+	return DebugAction::Kill;
+}
+
+void GdbStub::exited(const uint8_t status) {
+	std::string reply = "W";
+	appendHex(reply, status);
+	sendPacket(reply);
+	disconnect();
+}
+
+std::string GdbStub::handle(const std::string &packet) {
+	unsigned long address, length;
+	const char *end;
+
+	switch (packet[0]) {
+		case '?':
+			return stopReply;
+
+		case 'g': {
+			std::string hex;
+			for (unsigned n = 0; n < GDB_REGISTERS; n++) {
+				hex += readRegister(n);
+			}
+			return hex;
+		}
+
+		case 'G': {
+			// Every register is checked before any is written
+			size_t offset = 0;
+			std::vector<std::string> values;
+			for (unsigned n = 0; n < GDB_REGISTERS; n++) {
+				size_t size = readRegister(n).size();
+				values.push_back(packet.substr(1 + offset, size));
+				offset += size;
+			}
+			if (packet.size() != 1 + offset) {
+				return "E01";
+			}
+			Snapshot before;
+			chip8.saveState(before);
+			for (unsigned n = 0; n < GDB_REGISTERS; n++) {
+				if (!writeRegister(n, values[n])) {
+					chip8.loadState(before);
+					return "E01";
+				}
+			}
+			return "OK";
+		}
+
+		case 'p': {
+			unsigned long n = strtoul(packet.c_str() + 1, nullptr, 16);
+			return n < GDB_REGISTERS ? readRegister(static_cast<unsigned>(n)) : "E01";
+		}
+
+		case 'P': {
+			size_t equals = packet.find('=');
+			if (equals == std::string::npos) {
+				return "E01";
+			}
+			unsigned long n = strtoul(packet.c_str() + 1, nullptr, 16);
+			return n < GDB_REGISTERS && writeRegister(static_cast<unsigned>(n), packet.substr(equals + 1)) ? "OK" : "E01";
+		}
+
+		case 'm': {
+			if (!parseRange(packet.c_str() + 1, address, length, end) || address >= 4096) {
+				return "E01";
+			}
+			// Reads are cut at the end of memory and at the packet size
+			length = std::min(length, std::min(4096 - address, static_cast<unsigned long>(GDB_PACKET_SIZE / 2)));
+			std::string hex;
+			for (unsigned long i = 0; i < length; i++) {
+				appendHex(hex, chip8.memory[address + i]);
+			}
+			return hex;
+		}
+
+		case 'M': {
+			std::vector<uint8_t> bytes;
+			if (!parseRange(packet.c_str() + 1, address, length, end) || *end != ':'
+				|| !decodeHex(end + 1, bytes) || bytes.size() != length
+				|| address >= 4096 || length > 4096 - address) {
+				return "E01";
+			}
+			std::copy(bytes.begin(), bytes.end(), chip8.memory + address);
+			chip8.invalidateCode(static_cast<uint16_t>(address), static_cast<uint16_t>(length));
+			return "OK";
+		}
+
+		case 'Z':
+		case 'z':
+			return setPoint(packet, packet[0] == 'Z');
+
+		case 'H':
+		case 'T':
+			// The single thread
+			return "OK";
+
+		case 'q':
+			if (packet.compare(0, 10, "qSupported") == 0) {
+				char features[96];
+				snprintf(features, sizeof(features), "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", GDB_PACKET_SIZE);
+				return features;
+			}
+			if (packet.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+				if (!parseRange(packet.c_str() + 31, address, length, end)) {
+					return "E01";
+				}
+				std::string description = targetDescription();
+				if (address >= description.size()) {
+					return "l";
+				}
+				length = std::min(length, static_cast<unsigned long>(GDB_PACKET_SIZE - 8));
+				return (address + length < description.size() ? "m" : "l") + description.substr(address, length);
+			}
+			if (packet.compare(0, 6, "qRcmd,") == 0) {
+				std::vector<uint8_t> bytes;
+				if (!decodeHex(packet.substr(6), bytes)) {
+					return "E01";
+				}
+				std::string output = monitor(std::string(bytes.begin(), bytes.end()));
+				return output.empty() ? "OK" : encodeHex(output);
+			}
+			if (packet == "qAttached") {
+				return "1";
+			}
+			if (packet == "qC") {
+				return "QC1";
+			}
+			if (packet == "qfThreadInfo") {
+				return "m1";
+			}
+			if (packet == "qsThreadInfo") {
+				return "l";
+			}
+			if (packet == "qOffsets") {
+				return "Text=0;Data=0;Bss=0";
+			}
+			if (packet.compare(0, 7, "qSymbol") == 0) {
+				return "OK";
+			}
+			return "";
+
+		case 'Q':
+			return packet == "QStartNoAckMode" ? "OK" : "";
+	}
+
+	// Unsupported, e.g. X: the client falls back to M
+	return "";
+}
+
+std::string GdbStub::readRegister(const unsigned n) {
+	std::string hex;
+	if (n < 16) {
+		appendHex(hex, chip8.V[n]);
+	}
+	else if (n == 16 || n == 17 || n >= 21) {
+		uint16_t value = n == 16 ? chip8.I : n == 17 ? chip8.pc : chip8.stack[n - 21];
+		appendHex(hex, value & 0xFF);
+		appendHex(hex, value >> 8);
+	}
+	else {
+		appendHex(hex, n == 18 ? static_cast<uint8_t>(chip8.sp) : n == 19 ? chip8.delayTimer : chip8.soundTimer);
+	}
+	return hex;
+}
+
+bool GdbStub::writeRegister(const unsigned n, const std::string &hex) {
+	std::vector<uint8_t> bytes;
+	if (!decodeHex(hex, bytes) || bytes.size() * 2 != readRegister(n).size()) {
+		return false;
+	}
+	uint16_t value = bytes.size() == 2 ? static_cast<uint16_t>(bytes[0] | bytes[1] << 8) : bytes[0];
+
+	if (n < 16) {
+		chip8.V[n] = static_cast<uint8_t>(value);
+	}
+	else if (n == 16) {
+		chip8.I = value;
+	}
+	else if (n == 17) {
+		// The fetch reads two bytes
+		if (value > 4094) {
+			return false;
+		}
+		chip8.pc = value;
+	}
+	else if (n == 18) {
+		// -1 is the empty stack
+		int8_t sp = static_cast<int8_t>(value);
+		if (sp < -1 || sp > 15) {
+			return false;
+		}
+		chip8.sp = sp;
+	}
+	else if (n == 19) {
+		chip8.delayTimer = static_cast<uint8_t>(value);
+	}
+	else if (n == 20) {
+		chip8.soundTimer = static_cast<uint8_t>(value);
+		chip8.updateSound();
+	}
+	else {
+		chip8.stack[n - 21] = value;
+	}
+	return true;
+}
+
+std::string GdbStub::targetDescription(void) {
+	std::ostringstream xml;
+	xml << "<?xml version=\"1.0\"?>\n<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+		<< "<target version=\"1.0\">\n<feature name=\"org.chip8.core\">\n";
+	for (unsigned n = 0; n < GDB_REGISTERS; n++) {
+		std::string name;
+		const char *type = "uint8";
+		if (n < 16) {
+			name = std::string("v") + hexDigits[n];
+		}
+		else if (n < 21) {
+			static const char *names[] = { "i", "pc", "sp", "dt", "st" };
+			name = names[n - 16];
+			type = n == 16 ? "data_ptr" : n == 17 ? "code_ptr" : n == 18 ? "int8" : "uint8";
+		}
+		else {
+			name = "stack" + std::to_string(n - 21);
+			type = "code_ptr";
+		}
+		bool wide = n == 16 || n == 17 || n >= 21;
+		xml << "<reg name=\"" << name << "\" bitsize=\"" << (wide ? 16 : 8) << "\" type=\"" << type
+			<< "\" regnum=\"" << n << "\"/>\n";
+	}
+	xml << "</feature>\n</target>\n";
+	return xml.str();
+}
+
+std::string GdbStub::setPoint(const std::string &packet, const bool insert) {
+	// Z<type>,<addr>,<kind>[;conditions]; conditions are not advertised, the
+	// client evaluates its own and the monitor ones are evaluated here
+	unsigned long address, length;
+	const char *end;
+	if (packet.size() < 4 || !parseRange(packet.c_str() + 3, address, length, end) || address >= 4096) {
+		return "E01";
+	}
+
+	const char type = packet[1];
+	if (type == '0' || type == '1') {
+		breakpoints[address] = insert;
+		return "OK";
+	}
+
+	uint8_t kind = type == '2' ? GDB_WATCH_WRITE : type == '3' ? GDB_WATCH_READ : type == '4' ? GDB_WATCH_ACCESS : 0;
+	if (!kind) {
+		return "";
+	}
+	unsigned long last = address + std::min(std::max(length, 1ul), 4096 - address);
+	for (unsigned long i = address; i < last; i++) {
+		watchpoints[i] = insert ? watchpoints[i] | kind : watchpoints[i] & ~kind;
+	}
+	return "OK";
+}
+
+bool GdbStub::parseOperand(const std::string &text, Operand &operand) {
+	std::string name = text;
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+	char *end;
+
+	if (name.size() == 2 && name[0] == 'v' && hexValue(name[1]) >= 0) {
+		operand = { Operand::Register, static_cast<uint16_t>(hexValue(name[1])) };
+		return true;
+	}
+	if (name == "i" || name == "pc" || name == "sp" || name == "dt" || name == "st") {
+		operand.kind = name == "i" ? Operand::I : name == "pc" ? Operand::Pc : name == "sp" ? Operand::Sp
+			: name == "dt" ? Operand::DelayTimer : Operand::SoundTimer;
+		operand.value = 0;
+		return true;
+	}
+	if (name.size() > 2 && name.front() == '[' && name.back() == ']') {
+		// A byte of memory
+		unsigned long address = strtoul(name.c_str() + 1, &end, 0);
+		operand = { Operand::Memory, static_cast<uint16_t>(address) };
+		return *end == ']' && address < 4096;
+	}
+	unsigned long value = strtoul(name.c_str(), &end, 0);
+	operand = { Operand::Value, static_cast<uint16_t>(value) };
+	return !name.empty() && *end == '\0' && value <= 0xFFFF;
+}
+
+bool GdbStub::parseCondition(const std::string &text, Condition &condition) {
+	std::istringstream in(text);
+	std::string lhs, op, rhs, rest;
+	if (!(in >> lhs >> op >> rhs) || (in >> rest)) {
+		return false;
+	}
+
+	static const char *ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+	static const char codes[] = { '=', '!', '<', 'l', '>', 'g' };
+	condition.op = 0;
+	for (int i = 0; i < 6; i++) {
+		if (op == ops[i]) {
+			condition.op = codes[i];
+		}
+	}
+	condition.text = text;
+	return condition.op && parseOperand(lhs, condition.lhs) && parseOperand(rhs, condition.rhs);
+}
+
+int GdbStub::readOperand(const Operand &operand) {
+	switch (operand.kind) {
+		case Operand::Value: return operand.value;
+		case Operand::Register: return chip8.V[operand.value];
+		case Operand::I: return chip8.I;
+		case Operand::Pc: return chip8.pc;
+		case Operand::Sp: return chip8.sp;
+		case Operand::DelayTimer: return chip8.delayTimer;
+		case Operand::SoundTimer: return chip8.soundTimer;
+		case Operand::Memory: return chip8.memory[operand.value];
+	}
+	return 0;
+}
+
+bool GdbStub::evaluate(const Condition &condition) {
+	int lhs = readOperand(condition.lhs);
+	int rhs = readOperand(condition.rhs);
+	switch (condition.op) {
+		case '=': return lhs == rhs;
+		case '!': return lhs != rhs;
+		case '<': return lhs < rhs;
+		case 'l': return lhs <= rhs;
+		case '>': return lhs > rhs;
+		case 'g': return lhs >= rhs;
+	}
+	return true;
+}
+
+std::string GdbStub::monitor(const std::string &command) {
+	std::istringstream in(command);
+	std::string verb, where;
+	in >> verb >> where;
+	char *end;
+	unsigned long address = strtoul(where.c_str(), &end, 0);
+	bool validAddress = !where.empty() && *end == '\0' && address < 4096;
+
+	if (verb == "break" && validAddress) {
+		Condition condition = Condition();
+		std::string keyword, text;
+		if (in >> keyword) {
+			std::getline(in, text);
+			if (keyword != "if" || !parseCondition(text, condition)) {
+				return "Expected: break ADDR [if LHS OP RHS]\n";
+			}
+		}
+		conditions[static_cast<uint16_t>(address)] = condition;
+		conditional[address] = true;
+		return "";
+	}
+	if (verb == "delete" && (validAddress || where.empty())) {
+		if (where.empty()) {
+			conditions.clear();
+			std::fill_n(conditional, 4096, false);
+		}
+		else {
+			conditions.erase(static_cast<uint16_t>(address));
+			conditional[address] = false;
+		}
+		return "";
+	}
+	if (verb == "info" && where.empty()) {
+		std::ostringstream out;
+		char line[32];
+		for (auto &entry : conditions) {
+			snprintf(line, sizeof(line), "break 0x%03x", entry.first);
+			out << line << (entry.second.op ? " if" + entry.second.text : "") << "\n";
+		}
+		for (unsigned i = 0; i < 4096; i++) {
+			if (breakpoints[i] || watchpoints[i]) {
+				snprintf(line, sizeof(line), "%s 0x%03x%s%s%s\n", breakpoints[i] ? "gdb" : "watch", i,
+					watchpoints[i] & GDB_WATCH_WRITE ? " write" : "", watchpoints[i] & GDB_WATCH_READ ? " read" : "",
+					watchpoints[i] & GDB_WATCH_ACCESS ? " access" : "");
+				out << line;
+			}
+		}
+		return out.str();
+	}
+	return "Commands:\n"
+		"  break ADDR [if LHS OP RHS]  stop at ADDR, when the condition holds\n"
+		"  delete [ADDR]               remove one or all of them\n"
+		"  info                        list breakpoints and watchpoints\n"
+		"Operands are v0-vf, i, pc, sp, dt, st, [ADDR] for a memory byte or a\n"
+		"number; OP is one of == != < <= > >=.\n";
+}
+
+bool GdbStub::breakBefore(void) {
+	const uint16_t pc = chip8.pc;
+	// The instruction the guest stopped at runs once it is resumed
+	const bool first = resuming;
+	resuming = false;
+	if (pc >= 4095) {
+		return false;
+	}
+
+	if (!first && (breakpoints[pc] || (conditional[pc] && evaluate(conditions[pc])))) {
+		stop(signalReply(GDB_SIGTRAP));
+		return true;
+	}
+
+	// Memory the instruction accesses through I, reported once it ran
+	const uint16_t opcode = chip8.memory[pc] << 8 | chip8.memory[pc + 1];
+	const uint8_t x = opcode >> 8 & 0x0F;
+	uint8_t access = GDB_WATCH_READ;
+	unsigned length = 0;
+	if ((opcode & 0xF000) == 0xD000) {
+		length = (opcode & 0x0F) ? (opcode & 0x0F) : 32;
+	}
+	else if ((opcode & 0xF0FF) == 0xF033) {
+		length = 3;
+		access = GDB_WATCH_WRITE;
+	}
+	else if ((opcode & 0xF0FF) == 0xF055) {
+		length = x + 1;
+		access = GDB_WATCH_WRITE;
+	}
+	else if ((opcode & 0xF0FF) == 0xF065) {
+		length = x + 1;
+	}
+
+	const unsigned last = std::min(chip8.I + length, 4096u);
+	for (unsigned address = chip8.I; address < last; address++) {
+		const uint8_t kinds = watchpoints[address];
+		if (kinds & (access | GDB_WATCH_ACCESS)) {
+			const char *name = kinds & access ? (access == GDB_WATCH_WRITE ? "watch" : "rwatch") : "awatch";
+			char reply[32];
+			snprintf(reply, sizeof(reply), "T%02x%s:%x;", GDB_SIGTRAP, name, address);
+			watchHit = reply;
+			break;
+		}
+	}
+	return false;
+}
+
+bool GdbStub::breakAfter(void) {
+	if (!watchHit.empty()) {
+		stop(watchHit);
+		watchHit.clear();
+		return true;
+	}
+	if (stepping) {
+		stop(signalReply(GDB_SIGTRAP));
+		return true;
+	}
+	return false;
+}
+
+void GdbStub::faulted(const Fault fault) {
+	// The instruction did not run, neither did its memory access
+	watchHit.clear();
+	char message[64];
+	snprintf(message, sizeof(message), "%s at %03X\n", faultName(fault), chip8.pc);
+	console = message;
+	stop(signalReply(fault == Fault::InvalidOpcode || fault == Fault::KeyOutOfRange ? GDB_SIGILL : GDB_SIGSEGV));
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include "chip8.hpp"
+
+// Largest packet either side sends, advertised in qSupported
+#define GDB_PACKET_SIZE 4096
+
+// Kinds of memory watchpoint, as set by Z2/Z3/Z4
+#define GDB_WATCH_WRITE 0x01
+#define GDB_WATCH_READ 0x02
+#define GDB_WATCH_ACCESS 0x04
+
+// Registers in `g` packet order: V0-VF, I, pc, sp, the delay and sound
+// timers, then the 16 stack entries. Multi-byte registers are little-endian.
+#define GDB_REGISTERS 37
+
+// What the client wants once the guest is stopped
+enum class DebugAction {
+	Resume, // Continue or step
+	Detach, // Run on without the debugger
+	Kill    // The client killed the guest or went away
+};
+
+// Debug server speaking the GDB remote serial protocol on a local TCP port.
+// Attached with Chip8::setDebugger, it makes runUntilFault use the run loop
+// instantiation that asks breakBefore and breakAfter around every
+// instruction. Everything runs on the thread that runs the Chip8: accept
+// waits for a client, poll notices an interrupt while the guest runs and
+// serve answers packets while it is stopped.
+//
+// Software and hardware breakpoints are the same thing here. Conditional
+// breakpoints are set with `monitor break ADDR if LHS OP RHS`, evaluated by
+// the stub so a hot address never makes a round trip to the client.
+class GdbStub {
+private:
+	// One side of a breakpoint condition
+	struct Operand {
+		enum Kind : uint8_t { Value, Register, I, Pc, Sp, DelayTimer, SoundTimer, Memory } kind;
+		uint16_t value; // The constant, register number or address
+	};
+
+	// `monitor break` breakpoint, op 0 for an unconditional one
+	struct Condition {
+		Operand lhs;
+		Operand rhs;
+		char op; // '=' '!' '<' 'l' (<=) '>' 'g' (>=)
+		std::string text; // As typed, for `monitor info`
+	};
+
+	Chip8 &chip8;
+	uint16_t port;
+	int listener;
+	int connection; // -1 once the client is gone
+	bool noAck; // QStartNoAckMode, the client trusts TCP
+	char input[GDB_PACKET_SIZE];
+	size_t inputStart, inputEnd;
+
+	// Z0/Z1 breakpoints. GDB removes them at every stop, so the monitor
+	// ones are kept apart.
+	bool breakpoints[4096];
+	bool conditional[4096];
+	std::map<uint16_t, Condition> conditions;
+	uint8_t watchpoints[4096]; // GDB_WATCH_* bits per address
+
+	bool stopped;
+	bool replyPending; // The client waits for the stop reply
+	std::string stopReply; // Of the last stop, for `?`
+	std::string console;   // Sent as output before the stop reply
+	bool stepping;
+	bool resuming;        // No breakpoint at the first instruction after a resume
+	std::string watchHit; // Stop reply of a watchpoint the current instruction hits
+
+	int readByte(const bool wait);
+	bool sendPacket(const std::string &payload);
+	bool receivePacket(std::string &payload);
+	void disconnect(void);
+	void stop(const std::string &reply);
+	bool resume(const std::string &packet);
+	int readOperand(const Operand &operand);
+	bool evaluate(const Condition &condition);
+	bool parseOperand(const std::string &text, Operand &operand);
+	bool parseCondition(const std::string &text, Condition &condition);
+	std::string monitor(const std::string &command);
+	std::string readRegister(const unsigned n);
+	bool writeRegister(const unsigned n, const std::string &hex);
+	std::string targetDescription(void);
+	std::string setPoint(const std::string &packet, const bool insert);
+	std::string handle(const std::string &packet);
+
+public:
+	// Opens the listening socket on 127.0.0.1, throws if the port is taken
+	GdbStub(Chip8 &chip8, const uint16_t port);
+	~GdbStub();
+
+	GdbStub(const GdbStub&) = delete;
+	GdbStub& operator=(const GdbStub&) = delete;
+
+	// The listening port, the one picked by the system when 0 was asked for
+	uint16_t getPort(void);
+	// Blocks until a client connects. The guest starts out stopped.
+	void accept(void);
+	// Checks for an interrupt from the client without blocking
+	void poll(void);
+	bool isStopped(void);
+	// Answers packets until the client resumes, detaches or kills the guest
+	DebugAction serve(void);
+	// Tells the client the guest is gone for good
+	void exited(const uint8_t status);
+
+	// Called by the debugging run loop, true stops it
+	bool breakBefore(void);
+	bool breakAfter(void);
+	void faulted(const Fault fault);
+};
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "Histogram.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+#define HISTOGRAM_BAR 40
+
+Histogram::Histogram() {
+	reset();
+}
+
+void Histogram::reset(void) {
+	std::fill_n(buckets, HISTOGRAM_BUCKETS, 0);
+	count = 0;
+	sum = 0;
+	min = UINT64_MAX;
+	max = 0;
+}
+
+unsigned Histogram::bucketOf(const uint64_t value) {
+	// Small values get a bucket each
+	if (value < HISTOGRAM_SUB_BUCKETS) {
+		return static_cast<unsigned>(value);
+	}
+
+	// Most significant bit, by halving the range
+	unsigned msb = 0;
+	for (unsigned step = 32; step; step >>= 1) {
+		if (value >> (msb + step)) {
+			msb += step;
+		}
+	}
+	const unsigned shift = msb - HISTOGRAM_SUB_BITS;
+	const unsigned sub = static_cast<unsigned>(value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+	return (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucketLow(const unsigned bucket) {
+	if (bucket < HISTOGRAM_SUB_BUCKETS) {
+		return bucket;
+	}
+	const unsigned shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+	const uint64_t sub = bucket % HISTOGRAM_SUB_BUCKETS;
+	return (HISTOGRAM_SUB_BUCKETS + sub) << shift;
+}
+
+uint64_t Histogram::bucketHigh(const unsigned bucket) {
+	if (bucket < HISTOGRAM_SUB_BUCKETS) {
+		return bucket;
+	}
+	const unsigned shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+	return bucketLow(bucket) + ((1ULL << shift) - 1);
+}
+
+void Histogram::record(const uint64_t value) {
+	buckets[bucketOf(value)]++;
+	count++;
+	sum += value;
+	min = std::min(min, value);
+	max = std::max(max, value);
+}
+
+void Histogram::merge(const Histogram &other) {
+	for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+	sum += other.sum;
+	min = std::min(min, other.min);
+	max = std::max(max, other.max);
+}
+
+uint64_t Histogram::getCount(void) const {
+	return count;
+}
+
+uint64_t Histogram::getMin(void) const {
+	return count ? min : 0;
+}
+
+uint64_t Histogram::getMax(void) const {
+	return max;
+}
+
+double Histogram::getMean(void) const {
+	return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+uint64_t Histogram::percentile(const double p) const {
+	if (!count) {
+		return 0;
+	}
+
+	// Rank of the value, 1 based
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * count + 0.5));
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			return std::min(bucketHigh(i), max);
+		}
+	}
+	return max;
+}
+
+void Histogram::writeText(std::ostream &out, const uint64_t scale, const char *unit) const {
+	out << "n " << count;
+	if (!count) {
+		out << std::endl;
+		return;
+	}
+	out << std::fixed << std::setprecision(1)
+		<< ", min " << static_cast<double>(getMin()) / scale << unit
+		<< ", mean " << getMean() / scale << unit
+		<< ", p50 " << static_cast<double>(percentile(0.5)) / scale << unit
+		<< ", p90 " << static_cast<double>(percentile(0.9)) / scale << unit
+		<< ", p99 " << static_cast<double>(percentile(0.99)) / scale << unit
+		<< ", max " << static_cast<double>(max) / scale << unit << std::endl;
+
+	const uint64_t largest = *std::max_element(buckets, buckets + HISTOGRAM_BUCKETS);
+	for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (buckets[i]) {
+			out << "  " << std::setw(10) << static_cast<double>(bucketLow(i)) / scale << unit
+				<< std::setw(10) << buckets[i] << " "
+				<< std::string(std::max<uint64_t>(1, buckets[i] * HISTOGRAM_BAR / largest), '#')
+				<< std::endl;
+		}
+	}
+	out << std::defaultfloat;
+}
+
+void Histogram::writeJson(std::ostream &out) const {
+	out << "{\"count\": " << count
+		<< ", \"min\": " << getMin()
+		<< ", \"mean\": " << static_cast<uint64_t>(getMean())
+		<< ", \"p50\": " << percentile(0.5)
+		<< ", \"p90\": " << percentile(0.9)
+		<< ", \"p99\": " << percentile(0.99)
+		<< ", \"max\": " << max
+		<< ", \"buckets\": {";
+
+	// Sparse, keyed by the lower bound of the bucket
+	bool first = true;
+	for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (buckets[i]) {
+			out << (first ? "" : ", ") << "\"" << bucketLow(i) << "\": " << buckets[i];
+			first = false;
+		}
+	}
+	out << "}}";
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+// Log-linear buckets: every power of two is split into HISTOGRAM_SUB_BUCKETS
+// equal buckets, so a recorded value is known to about 12%, whatever its
+// magnitude, in a fixed amount of memory.
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+// Distribution of unsigned values, e.g. latencies in ns.
+// Recording is a few instructions and never allocates; not thread safe.
+class Histogram {
+private:
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+
+	static unsigned bucketOf(const uint64_t value);
+	static uint64_t bucketLow(const unsigned bucket);
+	static uint64_t bucketHigh(const unsigned bucket);
+
+public:
+	Histogram();
+
+	void reset(void);
+	void record(const uint64_t value);
+	void merge(const Histogram &other);
+
+	uint64_t getCount(void) const;
+	uint64_t getMin(void) const;
+	uint64_t getMax(void) const;
+	double getMean(void) const;
+	// Upper bound of the bucket holding the value below which a fraction p
+	// (0 to 1) of the recorded values lie, clamped to the largest value
+	uint64_t percentile(const double p) const;
+
+	// Values are divided by `scale` and printed with `unit`, e.g. 1000 and "us"
+	// for ns. Lists the non-empty buckets with a bar each.
+	void writeText(std::ostream &out, const uint64_t scale = 1, const char *unit = "") const;
+	// Unscaled, buckets keyed by their lower bound
+	void writeJson(std::ostream &out) const;
+};
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "Jit.hpp"
+#include <algorithm>
+#include <initializer_list>
+#include "opcodes.hpp"
+
+#ifdef CHIP8_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+// Longest block and the worst case of emitted bytes per instruction
+#define MAX_BLOCK_LENGTH 64
+#define MAX_INSTRUCTION_BYTES 32
+#define CODE_BUFFER_SIZE (1 << 20)
+
+namespace {
+
+// Appends raw x86-64 machine code.
+// Generated code follows the System V ABI: rdi points to V, rsi to I,
+// the next pc is returned in ax and only eax, ecx and edx are clobbered.
+struct Emitter {
+	uint8_t *p;
+
+	void byte(uint8_t b) { *p++ = b; }
+	void bytes(std::initializer_list<uint8_t> list) { for (auto b : list) *p++ = b; }
+	void word(uint16_t w) { byte(w & 0xFF); byte(w >> 8); }
+	void dword(uint32_t d) { word(d & 0xFFFF); word(d >> 16); }
+
+	void movRegImm(uint8_t x, uint8_t imm) { bytes({ 0xC6, 0x47, x, imm }); }     // mov byte [rdi+x], imm
+	void addRegImm(uint8_t x, uint8_t imm) { bytes({ 0x80, 0x47, x, imm }); }     // add byte [rdi+x], imm
+	void loadAl(uint8_t x) { bytes({ 0x8A, 0x47, x }); }                         // mov al, [rdi+x]
+	void storeAl(uint8_t x) { bytes({ 0x88, 0x47, x }); }                        // mov [rdi+x], al
+	void storeCl(uint8_t x) { bytes({ 0x88, 0x4F, x }); }                        // mov [rdi+x], cl
+	void loadCl(uint8_t x) { bytes({ 0x8A, 0x4F, x }); }                         // mov cl, [rdi+x]
+	void movEaxImm(uint32_t imm) { byte(0xB8); dword(imm); }                     // mov eax, imm
+	void movEdxImm(uint32_t imm) { byte(0xBA); dword(imm); }                     // mov edx, imm
+	void ret(void) { byte(0xC3); }
+};
+
+}
+
+Jit::Jit() : buffer(nullptr), capacity(0), used(0),
+	profile(QuirkProfile::Legacy), quirks(quirksOf(QuirkProfile::Legacy)) {
+#ifdef CHIP8_JIT_SUPPORTED
+	void *mapping = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping != MAP_FAILED) {
+		buffer = static_cast<uint8_t*>(mapping);
+		capacity = CODE_BUFFER_SIZE;
+	}
+#endif
+	stats = JitStats();
+	flush();
+	stats.flushes = 0;
+}
+
+Jit::~Jit() {
+#ifdef CHIP8_JIT_SUPPORTED
+	if (buffer) {
+		munmap(buffer, capacity);
+	}
+#endif
+}
+
+bool Jit::isAvailable(void) {
+	// Executable memory may be refused by a hardened kernel
+	return buffer != nullptr;
+}
+
+JitStats Jit::getStats(void) {
+	return stats;
+}
+
+void Jit::flush(void) {
+	used = 0;
+	std::fill_n(state, 4096, Untranslated);
+	std::fill_n(covered, 4096, false);
+	stats.flushes++;
+}
+
+void Jit::setQuirks(const QuirkProfile profile) {
+	if (profile != this->profile) {
+		this->profile = profile;
+		quirks = quirksOf(profile);
+		flush();
+	}
+}
+
+void Jit::invalidate(const uint16_t address, const uint16_t length) {
+	uint16_t last = std::min(address + length, 4096);
+	for (uint16_t i = address; i < last; i++) {
+		if (covered[i]) {
+			// Blocks are cheap to rebuild, self-modifying code is rare
+			flush();
+			return;
+		}
+	}
+}
+
+const JitBlock* Jit::lookup(const uint16_t pc, const uint8_t *memory) {
+	if (pc >= 4095) {
+		return nullptr;
+	}
+	if (state[pc] == Untranslated) {
+		translate(pc, memory);
+	}
+	return state[pc] == Translated ? &blocks[pc] : nullptr;
+}
+
+void Jit::translate(const uint16_t start, const uint8_t *memory) {
+	if (!buffer) {
+		state[start] = Interpreted;
+		return;
+	}
+	if (capacity - used < MAX_BLOCK_LENGTH * MAX_INSTRUCTION_BYTES) {
+		flush();
+	}
+
+	Emitter e = { buffer + used };
+	uint8_t *entry = e.p;
+	uint16_t pc = start;
+	uint16_t length = 0;
+	uint16_t lastOpcode = 0;
+	bool exited = false;
+
+	while (!exited && length < MAX_BLOCK_LENGTH && pc < 4095) {
+		uint16_t opcode = memory[pc] << 8 | memory[pc + 1];
+		uint8_t x = opcode >> 8 & 0x0F;
+		uint8_t y = opcode >> 4 & 0x0F;
+		uint8_t nn = opcode & 0x0FF;
+		uint16_t nnn = opcode & 0x0FFF;
+
+		switch (classifyOpCode(opcode)) {
+			case OpClass::LoadImm: e.movRegImm(x, nn); break;
+			case OpClass::AddImm: e.addRegImm(x, nn); break;
+			case OpClass::Move: e.loadAl(y); e.storeAl(x); break;
+			case OpClass::Or:
+			case OpClass::And:
+			case OpClass::Xor: {
+				e.loadAl(y);
+				switch (classifyOpCode(opcode)) {
+					case OpClass::Or: e.bytes({ 0x08, 0x47, x }); break;  // or [rdi+x], al
+					case OpClass::And: e.bytes({ 0x20, 0x47, x }); break; // and [rdi+x], al
+					default: e.bytes({ 0x30, 0x47, x }); break;           // xor [rdi+x], al
+				}
+				if (quirks.logicResetsVF) {
+					e.movRegImm(0xF, 0);
+				}
+				break;
+			}
+			case OpClass::AddReg: {
+				// VF is written first, the sum is then taken from the updated registers
+				e.loadAl(x);
+				e.bytes({ 0x02, 0x47, y });       // add al, [rdi+y]
+				e.bytes({ 0x0F, 0x92, 0xC1 });    // setc cl
+				e.storeCl(0xF);
+				e.loadAl(x);
+				e.bytes({ 0x02, 0x47, y });       // add al, [rdi+y]
+				e.storeAl(x);
+				break;
+			}
+			case OpClass::SubReg: {
+				e.loadAl(x);
+				e.bytes({ 0x3A, 0x47, y });       // cmp al, [rdi+y]
+				e.bytes({ 0x0F, 0x97, 0xC1 });    // seta cl
+				e.storeCl(0xF);
+				e.loadAl(x);
+				e.bytes({ 0x2A, 0x47, y });       // sub al, [rdi+y]
+				e.storeAl(x);
+				break;
+			}
+			case OpClass::ShiftRight: {
+				if (quirks.shiftUsesVY) {
+					// VX = VY >> 1, the flag is written first as in the interpreter
+					e.loadAl(y);
+					e.bytes({ 0x88, 0xC1 });          // mov cl, al
+					e.bytes({ 0x80, 0xE1, 0x01 });    // and cl, 1
+					e.storeCl(0xF);
+					e.bytes({ 0xD0, 0xE8 });          // shr al, 1
+					e.storeAl(x);
+					break;
+				}
+				e.loadAl(x);
+				e.bytes({ 0x24, 0x01 });          // and al, 1
+				e.storeAl(0xF);
+				e.bytes({ 0xD0, 0x6F, x });       // shr byte [rdi+x], 1
+				break;
+			}
+			case OpClass::SubNeg: {
+				e.loadAl(y);
+				e.bytes({ 0x3A, 0x47, x });       // cmp al, [rdi+x]
+				e.bytes({ 0x0F, 0x97, 0xC1 });    // seta cl
+				e.storeCl(0xF);
+				e.loadAl(y);
+				e.bytes({ 0x2A, 0x47, x });       // sub al, [rdi+x]
+				e.storeAl(x);
+				break;
+			}
+			case OpClass::ShiftLeft: {
+				if (quirks.shiftUsesVY) {
+					e.loadAl(y);
+					e.bytes({ 0x88, 0xC1 });          // mov cl, al
+					e.bytes({ 0xC0, 0xE9, 0x07 });    // shr cl, 7
+					e.storeCl(0xF);
+					e.bytes({ 0xD0, 0xE0 });          // shl al, 1
+					e.storeAl(x);
+					break;
+				}
+				e.loadAl(x);
+				e.bytes({ 0xC0, 0xE8, 0x07 });    // shr al, 7
+				e.storeAl(0xF);
+				e.bytes({ 0xD0, 0x67, x });       // shl byte [rdi+x], 1
+				break;
+			}
+			case OpClass::LoadI: {
+				e.bytes({ 0x66, 0xC7, 0x06 });    // mov word [rsi], nnn
+				e.word(nnn);
+				break;
+			}
+			case OpClass::AddI: {
+				if (!quirks.addISetsVF) {
+					e.bytes({ 0x0F, 0xB6, 0x47, x }); // movzx eax, byte [rdi+x]
+					e.bytes({ 0x66, 0x01, 0x06 });    // add [rsi], ax
+					break;
+				}
+				e.bytes({ 0x0F, 0xB6, 0x47, x }); // movzx eax, byte [rdi+x]
+				e.bytes({ 0x0F, 0xB7, 0x0E });    // movzx ecx, word [rsi]
+				e.bytes({ 0x01, 0xC1 });          // add ecx, eax
+				e.bytes({ 0x81, 0xF9 });          // cmp ecx, 0xFFF
+				e.dword(0xFFF);
+				e.bytes({ 0x0F, 0x97, 0xC2 });    // seta dl
+				e.bytes({ 0x88, 0x57, 0x0F });    // mov [rdi+0xF], dl
+				e.bytes({ 0x0F, 0xB6, 0x47, x }); // movzx eax, byte [rdi+x]
+				e.bytes({ 0x66, 0x01, 0x06 });    // add [rsi], ax
+				break;
+			}
+			case OpClass::Font: {
+				e.bytes({ 0x0F, 0xB6, 0x47, x }); // movzx eax, byte [rdi+x]
+				e.bytes({ 0x8D, 0x04, 0x80 });    // lea eax, [rax+rax*4]
+				e.bytes({ 0x66, 0x89, 0x06 });    // mov [rsi], ax
+				break;
+			}
+			case OpClass::Jump: {
+				e.movEaxImm(nnn);
+				e.ret();
+				exited = true;
+				break;
+			}
+			case OpClass::SkipEqImm:
+			case OpClass::SkipNeImm: {
+				e.movEaxImm(pc + 2);
+				e.movEdxImm(pc + 4);
+				e.bytes({ 0x80, 0x7F, x, nn });   // cmp byte [rdi+x], nn
+				// cmove / cmovne eax, edx
+				e.bytes({ 0x0F, classifyOpCode(opcode) == OpClass::SkipEqImm ? (uint8_t)0x44 : (uint8_t)0x45, 0xC2 });
+				e.ret();
+				exited = true;
+				break;
+			}
+			case OpClass::SkipEqReg:
+			case OpClass::SkipNeReg: {
+				e.movEaxImm(pc + 2);
+				e.movEdxImm(pc + 4);
+				e.loadCl(x);
+				e.bytes({ 0x3A, 0x4F, y });       // cmp cl, [rdi+y]
+				e.bytes({ 0x0F, classifyOpCode(opcode) == OpClass::SkipEqReg ? (uint8_t)0x44 : (uint8_t)0x45, 0xC2 });
+				e.ret();
+				exited = true;
+				break;
+			}
+			default: {
+				// Left to the interpreter
+				if (length == 0) {
+					state[start] = Interpreted;
+					return;
+				}
+				e.movEaxImm(pc);
+				e.ret();
+				exited = true;
+				continue;
+			}
+		}
+
+		covered[pc] = true;
+		covered[pc + 1] = true;
+		lastOpcode = opcode;
+		length++;
+		pc += 2;
+	}
+
+	if (!exited) {
+		// Block size limit or end of memory
+		e.movEaxImm(pc);
+		e.ret();
+	}
+
+	blocks[start].code = reinterpret_cast<BlockCode>(entry);
+	blocks[start].length = length;
+	blocks[start].lastOpcode = lastOpcode;
+	state[start] = Translated;
+	used = e.p - buffer;
+	stats.blocksCompiled++;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "quirks.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define CHIP8_JIT_SUPPORTED 1
+#endif
+
+// Translated block: takes the V registers and I, returns the next pc
+typedef uint16_t (*BlockCode)(uint8_t *V, uint16_t *I);
+
+struct JitBlock {
+	BlockCode code;
+	uint16_t length; // Instructions retired by one execution, 0 if nothing was translated
+	uint16_t lastOpcode; // Of the last instruction, left in Chip8::opcode as the interpreter would
+};
+
+struct JitStats {
+	uint64_t blocksCompiled;
+	uint64_t blocksExecuted;
+	uint64_t flushes; // Full invalidations, after writes to translated code or a full buffer
+};
+
+// Basic-block translator from CHIP-8 to x86-64.
+// A block covers straight-line register and I arithmetic and ends at the
+// first control flow, timer, key, memory or display instruction. Jumps and
+// skips are translated as the block exit, everything else is left to the
+// interpreter, which then runs from the returned pc.
+// Code is generated for one quirk profile, changing it drops every block.
+class Jit {
+private:
+	enum BlockState : uint8_t {
+		Untranslated,
+		Translated,
+		Interpreted
+	};
+
+	uint8_t *buffer;
+	size_t capacity;
+	size_t used;
+
+	JitBlock blocks[4096];
+	BlockState state[4096];
+	bool covered[4096]; // Memory bytes that were translated into some block
+	JitStats stats;
+	QuirkProfile profile;
+	Quirks quirks;
+
+	void translate(const uint16_t pc, const uint8_t *memory);
+
+public:
+	Jit();
+	~Jit();
+
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	bool isAvailable(void);
+	const JitBlock* lookup(const uint16_t pc, const uint8_t *memory);
+	void invalidate(const uint16_t address, const uint16_t length);
+	void flush(void);
+	void setQuirks(const QuirkProfile profile);
+	void countExecution(void) { stats.blocksExecuted++; }
+	JitStats getStats(void);
+};
@@ -0,0 +1,104 @@
+#include "LiveStats.hpp"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "Scheduler.hpp"
+
+LiveStats::LiveStats() : started(steadyNs()), sampled(started), seconds(0), lastPresent(0), presented(0),
+	current(), previous()
+{ }
+
+void LiveStats::present(const uint64_t now) {
+	if (lastPresent) {
+		filling.record(now - lastPresent);
+	}
+	lastPresent = now;
+	presented++;
+}
+
+bool LiveStats::isDue(const uint64_t now) const {
+	return now - sampled >= LIVE_STATS_INTERVAL_NS;
+}
+
+void LiveStats::sample(const EmulatorStats &stats, const uint64_t now) {
+	previous = current.machine;
+	current = stats;
+	seconds = (now - sampled) / 1e9;
+	sampled = now;
+
+	frameTime = filling;
+	filling.reset();
+	sessionFrameTime.merge(frameTime);
+	sessionEmulate.merge(current.emulate);
+}
+
+double LiveStats::rate(const uint64_t now, const uint64_t before) const {
+	return seconds > 0 ? (now - before) / seconds : 0;
+}
+
+std::string LiveStats::summary(void) const {
+	const Metrics &machine = current.machine;
+	const double keyWait = static_cast<double>(machine.keyWaitTicks) / TIMER_HZ + current.keyWaitNs / 1e9;
+	char text[512];
+	snprintf(text, sizeof(text),
+		"%.0f ips  %.1f ticks/s\n"
+		"%.1f fps  %.1f drawn/s\n"
+		"%.0f DXYN/s\n"
+		"frame   p50 %.1f  p99 %.1f ms\n"
+		"emulate p50 %.2f  p99 %.2f ms\n"
+		"key wait %.1f s  skipped %llu",
+		rate(machine.instructions, previous.instructions), rate(machine.frames, previous.frames),
+		rate(frameTime.getCount(), 0), rate(machine.drawFrames, previous.drawFrames),
+		rate(machine.drawCalls, previous.drawCalls),
+		frameTime.percentile(0.5) / 1e6, frameTime.percentile(0.99) / 1e6,
+		current.emulate.percentile(0.5) / 1e6, current.emulate.percentile(0.99) / 1e6,
+		keyWait, static_cast<unsigned long long>(current.framesSkipped));
+	return text;
+}
+
+void LiveStats::writeJson(std::ostream &out, const char *rom) const {
+	const Metrics &machine = current.machine;
+	out << "{\"rom\": \"";
+	for (const char *c = rom; *c; c++) {
+		out << (*c == '"' || *c == '\\' ? "\\" : "") << *c;
+	}
+	out << "\", \"uptime_s\": " << (sampled - started) / 1e9
+		<< ", \"instructions\": " << machine.instructions
+		<< ", \"ticks\": " << machine.frames
+		<< ", \"draw_frames\": " << machine.drawFrames
+		<< ", \"dxyn\": " << machine.drawCalls
+		<< ", \"key_wait_ticks\": " << machine.keyWaitTicks
+		<< ", \"key_wait_asleep_ns\": " << current.keyWaitNs
+		<< ", \"frames_published\": " << current.framesPublished
+		<< ", \"frames_skipped\": " << current.framesSkipped
+		<< ", \"frames_presented\": " << presented
+		<< ", \"interval_s\": " << seconds
+		<< ", \"ips\": " << rate(machine.instructions, previous.instructions)
+		<< ", \"ticks_per_s\": " << rate(machine.frames, previous.frames)
+		<< ", \"draw_frames_per_s\": " << rate(machine.drawFrames, previous.drawFrames)
+		<< ", \"dxyn_per_s\": " << rate(machine.drawCalls, previous.drawCalls)
+		<< ", \"present_fps\": " << rate(frameTime.getCount(), 0)
+		<< ", \"frame_time_ns\": ";
+	frameTime.writeJson(out);
+	out << ", \"emulate_ns\": ";
+	current.emulate.writeJson(out);
+	out << ", \"session_frame_time_ns\": ";
+	sessionFrameTime.writeJson(out);
+	out << ", \"session_emulate_ns\": ";
+	sessionEmulate.writeJson(out);
+	out << "}" << std::endl;
+}
+
+void LiveStats::dump(const std::string &path, const char *rom) const {
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary);
+		writeJson(out, rom);
+		if (!out.good()) {
+			throw std::runtime_error("Error: cannot write " + temporary);
+		}
+	}
+	if (rename(temporary.c_str(), path.c_str()) != 0) {
+		throw std::runtime_error("Error: cannot replace " + path);
+	}
+}
\ No newline at end of file
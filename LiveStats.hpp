@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "Emulator.hpp"
+#include "Histogram.hpp"
+
+// Interval of the rates, the overlay and the metrics dump
+#define LIVE_STATS_INTERVAL_NS 1000000000ull
+
+// Rates and percentiles of a running session for the stats overlay and the
+// metrics dump. Window thread only: present after every presented frame,
+// sample with Emulator::takeStats once isDue. Rates and the histograms
+// cover the last interval, counters and the session histograms everything
+// since the start.
+class LiveStats {
+private:
+	uint64_t started;
+	uint64_t sampled; // steadyNs of the last sample
+	double seconds;   // Length of the last interval
+	uint64_t lastPresent; // 0 before the first frame
+	uint64_t presented;
+
+	EmulatorStats current;
+	Metrics previous; // Of the sample before
+
+	Histogram frameTime;  // ns between presented frames, last interval
+	Histogram filling;    // The interval being recorded
+	Histogram sessionFrameTime;
+	Histogram sessionEmulate;
+
+	double rate(const uint64_t now, const uint64_t before) const;
+
+public:
+	LiveStats();
+
+	void present(const uint64_t now);
+	bool isDue(const uint64_t now) const;
+	void sample(const EmulatorStats &stats, const uint64_t now);
+
+	// A few short lines for the overlay
+	std::string summary(void) const;
+	void writeJson(std::ostream &out, const char *rom) const;
+	// Replaces `path` through a temporary file, a reader never sees half a
+	// dump. Throws if it cannot be written.
+	void dump(const std::string &path, const char *rom) const;
+};
\ No newline at end of file
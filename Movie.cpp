@@ -0,0 +1,172 @@
+#include "Movie.hpp"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "Rom.hpp"
+
+Movie::Movie(void) : header(), nextEvent(0), nextCheckpoint(0), lastDisplayHash(0) {
+	header.magic = MOVIE_MAGIC;
+	header.version = MOVIE_VERSION;
+}
+
+void Movie::begin(const char* romPath, const uint64_t seed, const uint32_t instructionsPerSecond,
+	const QuirkProfile quirks) {
+	header.romHash = RomStore::shared().load(romPath)->getHash();
+	header.seed = seed;
+	header.quirks = static_cast<uint8_t>(quirks);
+	header.instructionsPerSecond = instructionsPerSecond;
+	header.frames = 0;
+	events.clear();
+	checkpoints.clear();
+}
+
+void Movie::recordKey(const uint64_t frame, const uint64_t cycle, const uint8_t key, const bool pressed) {
+	MovieEvent event = {};
+	event.cycle = cycle;
+	event.frame = static_cast<uint32_t>(frame);
+	event.key = key;
+	event.pressed = pressed;
+	events.push_back(event);
+}
+
+void Movie::recordFrame(const uint64_t frame, const uint64_t displayHash) {
+	header.frames = static_cast<uint32_t>(frame);
+	lastDisplayHash = displayHash;
+	if (frame % MOVIE_CHECKPOINT_FRAMES == 0) {
+		checkpoints.push_back({ header.frames, 0, lastDisplayHash });
+	}
+}
+
+void Movie::save(const std::string &path) {
+	// The last tick is always verified
+	if (header.frames && (checkpoints.empty() || checkpoints.back().frame != header.frames)) {
+		checkpoints.push_back({ header.frames, 0, lastDisplayHash });
+	}
+	header.events = static_cast<uint32_t>(events.size());
+	header.checkpoints = static_cast<uint32_t>(checkpoints.size());
+
+	std::ofstream out(path, std::ios::binary);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)events.data(), events.size() * sizeof(MovieEvent));
+	out.write((const char*)checkpoints.data(), checkpoints.size() * sizeof(MovieCheckpoint));
+	if (out.fail()) {
+		throw std::runtime_error("Error: cannot write movie " + path);
+	}
+}
+
+void Movie::load(const std::string &path) {
+	std::ifstream in(path, std::ios::binary);
+	if (in.fail()) {
+		throw std::runtime_error("Error: cannot open movie " + path);
+	}
+
+	in.read((char*)&header, sizeof(header));
+	if (in.fail() || header.magic != MOVIE_MAGIC) {
+		throw std::runtime_error("Error: " + path + " is not a movie");
+	}
+	if (header.version != MOVIE_VERSION) {
+		throw std::runtime_error("Error: movie version");
+	}
+	if (header.quirks >= static_cast<uint8_t>(QuirkProfile::Count)) {
+		throw std::runtime_error("Error: movie quirk profile");
+	}
+
+	// The counts come from the file, a corrupt one must not allocate gigabytes
+	const std::streamoff start = in.tellg();
+	in.seekg(0, std::ios::end);
+	const uint64_t remaining = static_cast<uint64_t>(in.tellg() - start);
+	in.seekg(start);
+	if (static_cast<uint64_t>(header.events) * sizeof(MovieEvent)
+		+ static_cast<uint64_t>(header.checkpoints) * sizeof(MovieCheckpoint) > remaining) {
+		throw std::runtime_error("Error: " + path + " is not a movie");
+	}
+
+	events.resize(header.events);
+	checkpoints.resize(header.checkpoints);
+	in.read((char*)events.data(), events.size() * sizeof(MovieEvent));
+	in.read((char*)checkpoints.data(), checkpoints.size() * sizeof(MovieCheckpoint));
+	if (in.fail()) {
+		throw std::runtime_error("Error: movie " + path + " is truncated");
+	}
+	for (const MovieEvent &event : events) {
+		if (event.key > 0x0F) {
+			throw std::runtime_error("Error: " + path + " is not a movie");
+		}
+	}
+	nextEvent = 0;
+	nextCheckpoint = 0;
+}
+
+void Movie::prepare(Chip8 &chip8, const char* romPath) {
+	if (RomStore::shared().load(romPath)->getHash() != header.romHash) {
+		throw std::runtime_error("Error: the movie was recorded with another ROM");
+	}
+	chip8.setSeed(header.seed);
+	chip8.setQuirks(getQuirks());
+}
+
+bool Movie::applyKeys(Chip8 &chip8, const uint64_t frame) {
+	while (nextEvent < events.size() && events[nextEvent].frame <= frame) {
+		const MovieEvent &event = events[nextEvent];
+		if (event.frame != frame || event.cycle != chip8.getCycles()) {
+			char detail[128];
+			snprintf(detail, sizeof(detail), "key %X at frame %u, cycle %llu was recorded at cycle %llu",
+				event.key, static_cast<unsigned>(frame), static_cast<unsigned long long>(chip8.getCycles()),
+				static_cast<unsigned long long>(event.cycle));
+			desync = detail;
+			return false;
+		}
+
+		if (event.pressed) {
+			chip8.keyPress(event.key);
+		}
+		else {
+			chip8.keyRelease(event.key);
+		}
+		nextEvent++;
+	}
+	return true;
+}
+
+bool Movie::verifyFrame(const uint64_t frame, const uint64_t displayHash) {
+	while (nextCheckpoint < checkpoints.size() && checkpoints[nextCheckpoint].frame <= frame) {
+		const MovieCheckpoint &checkpoint = checkpoints[nextCheckpoint++];
+		if (checkpoint.frame == frame && checkpoint.displayHash != displayHash) {
+			char detail[128];
+			snprintf(detail, sizeof(detail), "display at frame %u is %016llx, recorded %016llx",
+				static_cast<unsigned>(frame), static_cast<unsigned long long>(displayHash),
+				static_cast<unsigned long long>(checkpoint.displayHash));
+			desync = detail;
+			return false;
+		}
+	}
+	return true;
+}
+
+const std::string& Movie::getDesync(void) {
+	return desync;
+}
+
+uint32_t Movie::getFrames(void) {
+	return header.frames;
+}
+
+uint32_t Movie::getInstructionsPerSecond(void) {
+	return header.instructionsPerSecond;
+}
+
+uint64_t Movie::getSeed(void) {
+	return header.seed;
+}
+
+QuirkProfile Movie::getQuirks(void) {
+	return static_cast<QuirkProfile>(header.quirks);
+}
+
+size_t Movie::getEventCount(void) {
+	return events.size();
+}
+
+size_t Movie::getCheckpointCount(void) {
+	return checkpoints.size();
+}
\ No newline at end of file
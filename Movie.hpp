@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+
+#define MOVIE_MAGIC 0x4D384843 // "CH8M"
+#define MOVIE_VERSION 1
+// Frames between two display hash checkpoints
+#define MOVIE_CHECKPOINT_FRAMES 60
+
+// File header, followed by `events` MovieEvents and `checkpoints` MovieCheckpoints
+struct MovieHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint8_t quirks; // QuirkProfile, 0 in movies that predate it is Legacy
+	uint8_t reserved;
+	uint64_t romHash; // Rom::getHash
+	uint64_t seed;
+	uint32_t instructionsPerSecond;
+	uint32_t frames; // Length of the recording in 60 Hz ticks
+	uint32_t events;
+	uint32_t checkpoints;
+};
+static_assert(sizeof(MovieHeader) == 40, "MovieHeader must be 40 bytes");
+
+// A key transition, applied before tick `frame` runs.
+// `cycle` is the instruction count at that point and catches a desync early.
+struct MovieEvent {
+	uint64_t cycle;
+	uint32_t frame;
+	uint8_t key;
+	uint8_t pressed;
+	uint16_t reserved;
+};
+static_assert(sizeof(MovieEvent) == 16, "MovieEvent must be 16 bytes");
+
+// Chip8::getDisplayHash after tick `frame - 1`, when `frame` ticks have run
+struct MovieCheckpoint {
+	uint32_t frame;
+	uint32_t reserved;
+	uint64_t displayHash;
+};
+static_assert(sizeof(MovieCheckpoint) == 16, "MovieCheckpoint must be 16 bytes");
+
+// An input movie: the key transitions of a session with the tick and
+// instruction they happened at, plus display hashes to verify a replay.
+// Guest timing only depends on the Scheduler, so a machine with the same
+// ROM, seed and rate that gets the same keys at the same ticks runs the
+// session again exactly, at any speed. The quirk profile is kept as well.
+class Movie {
+private:
+	MovieHeader header;
+	std::vector<MovieEvent> events;
+	std::vector<MovieCheckpoint> checkpoints;
+
+	// Replay position
+	size_t nextEvent;
+	size_t nextCheckpoint;
+	std::string desync;
+	uint64_t lastDisplayHash; // Becomes the final checkpoint
+
+public:
+	Movie(void);
+
+	// Recording
+	void begin(const char* romPath, const uint64_t seed, const uint32_t instructionsPerSecond,
+		const QuirkProfile quirks);
+	void recordKey(const uint64_t frame, const uint64_t cycle, const uint8_t key, const bool pressed);
+	// Called whenever a tick has completed, `frame` ticks in total
+	void recordFrame(const uint64_t frame, const uint64_t displayHash);
+	// Checkpoints the last recorded tick and writes the file
+	void save(const std::string &path);
+
+	// Replay
+	void load(const std::string &path);
+	// Seeds the machine, sets its quirks and checks the ROM it loaded
+	void prepare(Chip8 &chip8, const char* romPath);
+	// Presses and releases the keys due before tick `frame`.
+	// Returns false if the machine is not at the recorded instruction.
+	bool applyKeys(Chip8 &chip8, const uint64_t frame);
+	// Returns false if the display differs from the checkpoint of `frame`
+	bool verifyFrame(const uint64_t frame, const uint64_t displayHash);
+	// What went wrong after applyKeys or verifyFrame failed
+	const std::string& getDesync(void);
+
+	uint32_t getFrames(void);
+	uint32_t getInstructionsPerSecond(void);
+	uint64_t getSeed(void);
+	QuirkProfile getQuirks(void);
+	size_t getEventCount(void);
+	size_t getCheckpointCount(void);
+};
\ No newline at end of file
@@ -1,9 +1,9 @@
 #include "OpcodeException.hpp"
 
-OpCodeException::OpCodeException(uint16_t opCode, uint8_t offset) : OpCodeException("Invalid opcode", opCode, offset)
+OpCodeException::OpCodeException(uint16_t opCode, uint16_t offset) : OpCodeException("Invalid opcode", opCode, offset)
 { }
 
-OpCodeException::OpCodeException(std::string msg, uint16_t opCode, uint8_t offset) : msg(msg), opCode(opCode), offset(offset)
+OpCodeException::OpCodeException(std::string msg, uint16_t opCode, uint16_t offset) : msg(msg), opCode(opCode), offset(offset)
 { }
 
 std::string OpCodeException::getMessage(void) {
@@ -14,6 +14,6 @@ uint16_t OpCodeException::getOpCode(void) {
 	return opCode;
 }
 
-uint8_t OpCodeException::getOffset(void) {
+uint16_t OpCodeException::getOffset(void) {
 	return offset;
 }
\ No newline at end of file
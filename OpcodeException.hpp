@@ -1,3 +1,4 @@
+#pragma once
 #include <exception>
 #include <string>
 #include <cstdint>
@@ -6,21 +7,21 @@ class OpCodeException : public std::exception {
 private:
 	std::string msg;
 	uint16_t opCode;
-	uint8_t offset;
+	uint16_t offset;
 
 public:
 	OpCodeException(
 		uint16_t opCode,
-		uint8_t memOffset
+		uint16_t memOffset
 	);
 
 	OpCodeException(
 		std::string msg,
 		uint16_t opCode,
-		uint8_t memOffset
+		uint16_t memOffset
 	);
 
 	std::string getMessage(void);
 	uint16_t getOpCode(void);
-	uint8_t getOffset(void);
+	uint16_t getOffset(void);
 };
\ No newline at end of file
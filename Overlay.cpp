@@ -0,0 +1,62 @@
+#include "Overlay.hpp"
+
+// Monospaced first, the numbers do not jump around
+static const char *systemFonts[] = {
+	"C:/Windows/Fonts/consola.ttf",
+	"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+	"/usr/share/fonts/dejavu/DejaVuSansMono.ttf",
+	"/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+	"/System/Library/Fonts/Menlo.ttc",
+	"C:/Windows/Fonts/arial.ttf",
+	"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
+};
+
+Overlay::Overlay() : loaded(false), visible(false) {
+	text.setCharacterSize(OVERLAY_CHARACTER_SIZE);
+	text.setFillColor(sf::Color::Yellow);
+	text.setPosition(8, 6);
+	background.setFillColor(sf::Color(0, 0, 0, 170));
+}
+
+bool Overlay::loadFont(const char *path) {
+	if (path) {
+		loaded = font.loadFromFile(path);
+	}
+	else {
+		// Every miss would print an error
+		std::streambuf *errors = sf::err().rdbuf(nullptr);
+		for (const char *candidate : systemFonts) {
+			if ((loaded = font.loadFromFile(candidate))) {
+				break;
+			}
+		}
+		sf::err().rdbuf(errors);
+	}
+	if (loaded) {
+		text.setFont(font);
+	}
+	return loaded;
+}
+
+void Overlay::setVisible(const bool visible) {
+	this->visible = visible;
+}
+
+bool Overlay::isVisible(void) {
+	return visible;
+}
+
+void Overlay::setText(const std::string &lines) {
+	text.setString(lines);
+	const sf::FloatRect bounds = text.getGlobalBounds();
+	background.setPosition(bounds.left - 6, bounds.top - 4);
+	background.setSize(sf::Vector2f(bounds.width + 12, bounds.height + 8));
+}
+
+void Overlay::draw(sf::RenderTarget &target) {
+	if (!visible || !loaded) {
+		return;
+	}
+	target.draw(background);
+	target.draw(text);
+}
\ No newline at end of file
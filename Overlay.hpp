@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <SFML/Graphics.hpp>
+
+#define OVERLAY_CHARACTER_SIZE 16
+
+// Stats text in a corner of the window, see LiveStats::summary.
+// SFML has no built-in font: one is loaded from the given path or, without
+// one, from the usual system places. Without a font nothing is drawn.
+class Overlay {
+private:
+	sf::Font font;
+	sf::Text text;
+	sf::RectangleShape background;
+	bool loaded;
+	bool visible;
+
+public:
+	Overlay();
+
+	// nullptr searches the system fonts. False if no font could be loaded.
+	bool loadFont(const char *path);
+	void setVisible(const bool visible);
+	bool isVisible(void);
+	void setText(const std::string &lines);
+	void draw(sf::RenderTarget &target);
+};
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+Profiler::Profiler() {
+	reset();
+}
+
+void Profiler::reset(void) {
+	std::fill_n(classCounts, static_cast<int>(OpClass::Count), 0);
+	std::fill_n(pcVisits, 4096, 0);
+	instructions = 0;
+	frames = 0;
+	drawFrames = 0;
+	frameDrawn = false;
+	waits = 0;
+	waitFrames = 0;
+	waitNs = 0;
+	waiting = false;
+}
+
+void Profiler::frame(const bool waitingForKey) {
+	frames++;
+	if (frameDrawn) {
+		drawFrames++;
+		frameDrawn = false;
+	}
+	if (waitingForKey) {
+		waitFrames++;
+	}
+}
+
+void Profiler::beginWait(void) {
+	if (!waiting) {
+		waiting = true;
+		waits++;
+		waitStart = std::chrono::steady_clock::now();
+	}
+}
+
+void Profiler::endWait(void) {
+	if (waiting) {
+		waiting = false;
+		waitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - waitStart).count();
+	}
+}
+
+uint64_t Profiler::getInstructions(void) {
+	return instructions;
+}
+
+uint64_t Profiler::getClassCount(const OpClass opClass) {
+	return classCounts[static_cast<int>(opClass)];
+}
+
+uint64_t Profiler::getPcVisits(const uint16_t pc) {
+	return pcVisits[pc & 0xFFF];
+}
+
+void Profiler::writeText(std::ostream &out, const size_t hotSpots) {
+	out << "instructions: " << instructions << std::endl
+		<< "frames: " << frames << " (" << drawFrames << " with drawing)" << std::endl
+		<< "FX0A waits: " << waits << ", " << waitFrames << " frames, "
+		<< waitNs / 1000 << "us" << std::endl;
+
+	// Classes by descending count
+	std::vector<int> order;
+	for (int i = 0; i < static_cast<int>(OpClass::Count); i++) {
+		if (classCounts[i]) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+		return classCounts[a] > classCounts[b];
+	});
+
+	out << "opcodes:" << std::endl;
+	for (int i : order) {
+		out << "  " << std::setw(7) << std::left << opClassName(static_cast<OpClass>(i)) << std::right
+			<< std::setw(14) << classCounts[i]
+			<< std::setw(8) << std::fixed << std::setprecision(2) << 100.0 * classCounts[i] / instructions << "%"
+			<< std::endl;
+	}
+
+	std::vector<uint16_t> pcs;
+	for (uint16_t pc = 0; pc < 4096; pc++) {
+		if (pcVisits[pc]) {
+			pcs.push_back(pc);
+		}
+	}
+	size_t count = std::min(hotSpots, pcs.size());
+	std::partial_sort(pcs.begin(), pcs.begin() + count, pcs.end(), [this](uint16_t a, uint16_t b) {
+		return pcVisits[a] > pcVisits[b] || (pcVisits[a] == pcVisits[b] && a < b);
+	});
+
+	out << "hot spots:" << std::endl;
+	for (size_t i = 0; i < count; i++) {
+		out << "  " << std::hex << std::setw(3) << std::setfill('0') << std::uppercase << pcs[i]
+			<< std::dec << std::setfill(' ') << std::nouppercase
+			<< std::setw(14) << pcVisits[pcs[i]]
+			<< std::setw(8) << 100.0 * pcVisits[pcs[i]] / instructions << "%"
+			<< std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+void Profiler::writeJson(std::ostream &out) {
+	out << "{\"instructions\": " << instructions
+		<< ", \"frames\": " << frames
+		<< ", \"draw_frames\": " << drawFrames
+		<< ", \"key_waits\": " << waits
+		<< ", \"key_wait_frames\": " << waitFrames
+		<< ", \"key_wait_ns\": " << waitNs
+		<< ", \"opcodes\": {";
+
+	bool first = true;
+	for (int i = 0; i < static_cast<int>(OpClass::Count); i++) {
+		if (classCounts[i]) {
+			out << (first ? "" : ", ") << "\"" << opClassName(static_cast<OpClass>(i)) << "\": " << classCounts[i];
+			first = false;
+		}
+	}
+
+	// Sparse histogram keyed by address
+	out << "}, \"pc\": {";
+	first = true;
+	for (uint16_t pc = 0; pc < 4096; pc++) {
+		if (pcVisits[pc]) {
+			out << (first ? "" : ", ") << "\"" << pc << "\": " << pcVisits[pc];
+			first = false;
+		}
+	}
+	out << "}}";
+}
+
+void Profiler::write(std::ostream &out, const ProfileFormat format) {
+	if (format == ProfileFormat::Json) {
+		writeJson(out);
+		out << std::endl;
+	}
+	else if (format == ProfileFormat::Text) {
+		writeText(out);
+	}
+}
\ No newline at end of file
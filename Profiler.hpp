@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "opcodes.hpp"
+
+enum class ProfileFormat {
+	None,
+	Text,
+	Json
+};
+
+// Execution profile of one Chip8 instance.
+// Only compiled into Chip8 with CHIP8_PROFILING; see Chip8::setProfiling.
+// Instructions are counted as they are interpreted, JIT blocks are not
+// used while a profile is being recorded.
+class Profiler {
+private:
+	uint64_t classCounts[static_cast<int>(OpClass::Count)];
+	uint64_t pcVisits[4096];
+	uint64_t instructions;
+
+	// 60 Hz frames and the frames in which 00E0 or DXYN ran
+	uint64_t frames;
+	uint64_t drawFrames;
+	bool frameDrawn;
+
+	// Time blocked in FX0A
+	uint64_t waits;
+	uint64_t waitFrames;
+	uint64_t waitNs;
+	bool waiting;
+	std::chrono::steady_clock::time_point waitStart;
+
+public:
+	Profiler();
+
+	void reset(void);
+
+	inline void instruction(const uint16_t pc, const uint16_t opcode) {
+		OpClass opClass = classifyOpCode(opcode);
+		classCounts[static_cast<int>(opClass)]++;
+		pcVisits[pc & 0xFFF]++;
+		instructions++;
+		// Everything that changes the screen, as the core's own frameDrawn
+		switch (opClass) {
+			case OpClass::Draw: case OpClass::Draw16: case OpClass::Cls: case OpClass::ScrollDown:
+			case OpClass::ScrollRight: case OpClass::ScrollLeft: case OpClass::LowRes: case OpClass::HighRes:
+				frameDrawn = true;
+				break;
+			default:
+				break;
+		}
+	}
+	void frame(const bool waitingForKey);
+	void beginWait(void);
+	void endWait(void);
+
+	uint64_t getInstructions(void);
+	uint64_t getClassCount(const OpClass opClass);
+	uint64_t getPcVisits(const uint16_t pc);
+
+	void writeText(std::ostream &out, const size_t hotSpots = 16);
+	void writeJson(std::ostream &out);
+	void write(std::ostream &out, const ProfileFormat format);
+};
\ No newline at end of file
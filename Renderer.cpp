@@ -0,0 +1,76 @@
+#include "Renderer.hpp"
+
+Renderer::Renderer(const unsigned scale, const sf::Color pixelOn, const sf::Color pixelOff)
+	: pixelOn(pixelOn), pixelOff(pixelOff), scale(scale), highRes(false) {
+	texture.create(DISPLAY_HIRES_WIDTH, DISPLAY_HIRES_HEIGHT);
+	sprite.setTexture(texture);
+
+	// Start from a blank screen
+	const uint64_t blank[DISPLAY_WORDS] = {};
+	setMode<LowRes>();
+	upload<LowRes>(blank, allRows<LowRes>());
+}
+
+template <typename G>
+void Renderer::fillRow(const uint64_t *words, const unsigned y) {
+	sf::Uint8 *pixel = rgba + y * G::width * 4;
+
+	for (unsigned x = 0; x < G::width; x++) {
+		const sf::Color &color = getPixel<G>(words, x, y) ? pixelOn : pixelOff;
+		*pixel++ = color.r;
+		*pixel++ = color.g;
+		*pixel++ = color.b;
+		*pixel++ = color.a;
+	}
+}
+
+template <typename G>
+void Renderer::upload(const uint64_t *words, const uint64_t dirtyRows) {
+	for (unsigned y = 0; y < G::height; y++) {
+		if (dirtyRows >> y & 1) {
+			fillRow<G>(words, y);
+			texture.update(rgba + y * G::width * 4, G::width, 1, 0, y);
+		}
+	}
+}
+
+template <typename G>
+void Renderer::setMode(void) {
+	// Only the top left corner of the texture is shown in 64x32 mode
+	sprite.setTextureRect(sf::IntRect(0, 0, G::width, G::height));
+	float pixelScale = static_cast<float>(scale) * DISPLAY_WIDTH / G::width;
+	sprite.setScale(pixelScale, pixelScale);
+}
+
+bool Renderer::update(const uint64_t (&words)[DISPLAY_WORDS], uint64_t dirtyRows, const bool highRes) {
+	if (highRes != this->highRes) {
+		// Every row of the new mode has to be uploaded
+		this->highRes = highRes;
+		dirtyRows = ~0ULL;
+		if (highRes) {
+			setMode<HighRes>();
+		}
+		else {
+			setMode<LowRes>();
+		}
+	}
+
+	// Nothing changed, the frame on screen is still valid
+	if (!dirtyRows) {
+		return false;
+	}
+
+	if (highRes) {
+		upload<HighRes>(words, dirtyRows);
+	}
+	else {
+		upload<LowRes>(words, dirtyRows);
+	}
+
+	return true;
+}
+
+void Renderer::draw(sf::RenderTarget &target) {
+	// One draw call for the whole screen
+	target.draw(sprite);
+}
\ No newline at end of file
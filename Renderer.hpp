@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "display.hpp"
+
+// Draws the Chip8 display as a single scaled texture.
+// Only rows reported dirty by the core are uploaded again. Both display
+// modes fill the same window, 128x64 with pixels of half the size.
+class Renderer {
+private:
+	sf::Texture texture;
+	sf::Sprite sprite;
+	sf::Color pixelOn;
+	sf::Color pixelOff;
+	unsigned scale; // Window pixels per 64x32 pixel
+	bool highRes;
+	sf::Uint8 rgba[DISPLAY_HIRES_WIDTH * DISPLAY_HIRES_HEIGHT * 4];
+
+	template <typename G> void fillRow(const uint64_t *words, const unsigned y);
+	template <typename G> void upload(const uint64_t *words, const uint64_t dirtyRows);
+	template <typename G> void setMode(void);
+
+public:
+	Renderer(const unsigned scale, const sf::Color pixelOn, const sf::Color pixelOff);
+
+	bool update(const uint64_t (&words)[DISPLAY_WORDS], uint64_t dirtyRows, const bool highRes);
+	void draw(sf::RenderTarget &target);
+};
\ No newline at end of file
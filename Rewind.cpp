@@ -0,0 +1,62 @@
+#include "Rewind.hpp"
+#include "delta.hpp"
+
+Rewind::Rewind(size_t budgetBytes) : head(), current(), hasHead(false), bytes(0), budget(budgetBytes)
+{ }
+
+void Rewind::push(Chip8 &chip8) {
+	chip8.saveState(current);
+
+	if (hasHead) {
+		encodeDelta(reinterpret_cast<const uint8_t*>(&head), reinterpret_cast<const uint8_t*>(&current),
+			sizeof(Snapshot), scratch);
+
+		bytes += scratch.size();
+		deltas.push_back(scratch);
+
+		while (bytes > budget && !deltas.empty()) {
+			bytes -= deltas.front().size();
+			deltas.pop_front();
+		}
+	}
+
+	head = current;
+	hasHead = true;
+}
+
+bool Rewind::step(Chip8 &chip8) {
+	if (!hasHead) {
+		return false;
+	}
+	if (deltas.empty()) {
+		// Oldest state left, stay on it
+		chip8.loadState(head);
+		return false;
+	}
+
+	const std::vector<uint8_t> &delta = deltas.back();
+	if (!applyDelta(reinterpret_cast<uint8_t*>(&head), sizeof(Snapshot), delta.data(), delta.size())) {
+		// The head is no longer a recorded state, the machine stays where it is
+		clear();
+		return false;
+	}
+	bytes -= delta.size();
+	deltas.pop_back();
+
+	chip8.loadState(head);
+	return true;
+}
+
+void Rewind::clear(void) {
+	deltas.clear();
+	bytes = 0;
+	hasHead = false;
+}
+
+size_t Rewind::getDepth(void) {
+	return deltas.size();
+}
+
+size_t Rewind::getBytes(void) {
+	return bytes;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "chip8.hpp"
+
+// Rewind history kept as XOR/RLE deltas between consecutive snapshots.
+// Only the newest snapshot is stored in full; stepping back applies the
+// newest delta to it. The oldest deltas are dropped once the byte budget
+// is exceeded.
+class Rewind {
+private:
+	Snapshot head;
+	Snapshot current;
+	bool hasHead;
+	std::deque<std::vector<uint8_t>> deltas;
+	std::vector<uint8_t> scratch;
+	size_t bytes;
+	size_t budget;
+
+public:
+	Rewind(size_t budgetBytes = 4 << 20);
+
+	void push(Chip8 &chip8);
+	bool step(Chip8 &chip8);
+	void clear(void);
+
+	size_t getDepth(void);
+	size_t getBytes(void);
+};
@@ -0,0 +1,248 @@
+#include "Rom.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROM_POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Rom::Rom(std::vector<uint8_t> bytes) : bytes(std::move(bytes)), hash(0xcbf29ce484222325ULL) {
+	for (uint8_t byte : this->bytes) {
+		hash ^= byte;
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+const uint8_t* Rom::getData(void) const {
+	return bytes.data();
+}
+
+size_t Rom::getSize(void) const {
+	return bytes.size();
+}
+
+uint64_t Rom::getHash(void) const {
+	return hash;
+}
+
+QuirkProfile Rom::detectQuirks(void) const {
+	// Follows the control flow, so sprite data that happens to look like
+	// an extension is not counted. Offsets are relative to ROM_START, an
+	// address below it wraps to a large offset and is dropped.
+	std::vector<bool> visited(bytes.size(), false);
+	std::vector<uint32_t> pending = { 0 };
+	bool schip = false;
+	bool xochip = false;
+
+	while (!pending.empty()) {
+		uint32_t offset = pending.back();
+		pending.pop_back();
+		if (offset + 1 >= bytes.size() || visited[offset]) {
+			continue;
+		}
+		visited[offset] = true;
+
+		const uint16_t opcode = bytes[offset] << 8 | bytes[offset + 1];
+		const uint32_t target = static_cast<uint32_t>((opcode & 0x0FFF) - ROM_START);
+		uint32_t next = offset + 2;
+		switch (opcode >> 12) {
+			case 0x0: {
+				if ((opcode & 0xFFF0) == 0x00D0) {
+					xochip = true; // 00DN, scroll up
+				}
+				// 00CN and 00FB-00FF; any other 0NNN is a machine code call on the VIP
+				else if (((opcode & 0xFFF0) == 0x00C0 && (opcode & 0x0F)) || (opcode >= 0x00FB && opcode <= 0x00FF)) {
+					schip = true;
+				}
+				if (opcode == 0x00EE || opcode == 0x00FD) {
+					continue;
+				}
+				break;
+			}
+			case 0x1: {
+				pending.push_back(target);
+				continue;
+			}
+			case 0x2: {
+				pending.push_back(target);
+				break;
+			}
+			case 0x5: {
+				if ((opcode & 0x0F) == 0x2 || (opcode & 0x0F) == 0x3) {
+					xochip = true; // Save and load of a register range
+					break;
+				}
+				pending.push_back(offset + 4);
+				break;
+			}
+			case 0x3:
+			case 0x4:
+			case 0x9:
+			case 0xE: {
+				pending.push_back(offset + 4);
+				break;
+			}
+			case 0xB: {
+				// The target depends on a register
+				continue;
+			}
+			case 0xF: {
+				const uint8_t nn = opcode & 0x0FF;
+				if (opcode == 0xF000) {
+					xochip = true; // I = the next word
+					next = offset + 4;
+				}
+				else if (opcode == 0xF002 || nn == 0x01 || nn == 0x3A) {
+					xochip = true; // Audio pattern, bit planes, pitch
+				}
+				else if (nn == 0x30 || nn == 0x75 || nn == 0x85) {
+					schip = true;
+				}
+				break;
+			}
+			default: break;
+		}
+		pending.push_back(next);
+	}
+
+	// XO-CHIP includes the SUPER-CHIP instructions
+	return xochip ? QuirkProfile::XoChip : schip ? QuirkProfile::Schip : QuirkProfile::CosmacVip;
+}
+
+static void checkSize(const std::string &path, const uint64_t size) {
+	if (size > ROM_MAX_SIZE) {
+		throw std::runtime_error("Error: " + path + " is larger than the " + std::to_string(ROM_MAX_SIZE) + " bytes of program memory");
+	}
+}
+
+#ifdef ROM_POSIX
+static int64_t modifiedNs(const struct stat &status) {
+#ifdef __APPLE__
+	return static_cast<int64_t>(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+	return static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+}
+
+// False if the file does not exist
+static bool fileStatus(const std::string &path, int64_t &modified, uint64_t &size) {
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0) {
+		return false;
+	}
+	modified = modifiedNs(status);
+	size = static_cast<uint64_t>(status.st_size);
+	return true;
+}
+
+static std::vector<uint8_t> readFile(const std::string &path, int64_t &modified, uint64_t &size) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Error: file");
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		close(fd);
+		throw std::runtime_error("Error: file");
+	}
+	modified = modifiedNs(status);
+	size = static_cast<uint64_t>(status.st_size);
+	try {
+		checkSize(path, size);
+	}
+	catch (...) {
+		close(fd);
+		throw;
+	}
+
+	// A ROM is at most a few KB, one read straight into the image is cheaper than a mapping
+	std::vector<uint8_t> bytes(size);
+	size_t done = 0;
+	while (done < size) {
+		ssize_t got = read(fd, bytes.data() + done, size - done);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			close(fd);
+			throw std::runtime_error("Error: cannot read " + path);
+		}
+		done += static_cast<size_t>(got);
+	}
+	close(fd);
+	return bytes;
+}
+#else
+static bool fileStatus(const std::string &, int64_t &, uint64_t &) {
+	// Without stat every load reads the file again
+	return false;
+}
+
+static std::vector<uint8_t> readFile(const std::string &path, int64_t &modified, uint64_t &size) {
+	std::ifstream rom(path, std::ios::binary);
+	if (rom.fail()) {
+		throw std::runtime_error("Error: file");
+	}
+
+	rom.seekg(0, rom.end);
+	size = static_cast<uint64_t>(rom.tellg());
+	rom.seekg(0, rom.beg);
+	modified = 0;
+	checkSize(path, size);
+
+	std::vector<uint8_t> bytes(size);
+	rom.read((char*)bytes.data(), size);
+	return bytes;
+}
+#endif
+
+std::shared_ptr<const Rom> RomStore::load(const std::string &path) {
+	int64_t modified;
+	uint64_t size;
+	bool exists = fileStatus(path, modified, size);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = byPath.find(path);
+		if (exists && cached != byPath.end() && cached->second.modified == modified && cached->second.size == size) {
+			return cached->second.rom;
+		}
+	}
+
+	// Read outside the lock, workers loading different ROMs do not wait for each other
+	std::shared_ptr<const Rom> rom(new Rom(readFile(path, modified, size)));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto same = byHash.find(rom->getHash());
+	if (same != byHash.end() && same->second->getSize() == rom->getSize()
+		&& memcmp(same->second->getData(), rom->getData(), rom->getSize()) == 0) {
+		rom = same->second;
+	}
+	else {
+		byHash[rom->getHash()] = rom;
+	}
+	byPath[path] = { rom, modified, size };
+	return rom;
+}
+
+void RomStore::clear(void) {
+	std::lock_guard<std::mutex> lock(mutex);
+	byPath.clear();
+	byHash.clear();
+}
+
+size_t RomStore::getSize(void) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return byHash.size();
+}
+
+RomStore& RomStore::shared(void) {
+	static RomStore store;
+	return store;
+}
\ No newline at end of file
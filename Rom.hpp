@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "quirks.hpp"
+
+#define ROM_START 0x200
+#define ROM_MAX_SIZE (4096 - ROM_START)
+
+// A validated ROM image, immutable once loaded
+class Rom {
+private:
+	std::vector<uint8_t> bytes;
+	uint64_t hash; // FNV-1a of the bytes
+
+public:
+	Rom(std::vector<uint8_t> bytes);
+
+	const uint8_t* getData(void) const;
+	size_t getSize(void) const;
+	uint64_t getHash(void) const;
+	// Guesses the interpreter the program was written for from the
+	// instructions reachable from the entry point: SUPER-CHIP or XO-CHIP
+	// extensions, otherwise the COSMAC VIP
+	QuirkProfile detectQuirks(void) const;
+};
+
+// Content-addressed cache of ROM images shared by all instances in the process.
+// Files are read once, checked against the 3584 bytes above 0x200 and
+// hashed once; later loads of the same unchanged path only stat the file,
+// and different paths with the same content share one image.
+class RomStore {
+private:
+	struct Entry {
+		std::shared_ptr<const Rom> rom;
+		int64_t modified; // Of the file when it was read, to notice edits
+		uint64_t size;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Entry> byPath;
+	std::unordered_map<uint64_t, std::shared_ptr<const Rom>> byHash;
+
+public:
+	// Throws std::runtime_error if the file cannot be read or does not fit
+	std::shared_ptr<const Rom> load(const std::string &path);
+	void clear(void);
+	size_t getSize(void);
+
+	// The store Chip8::loadROM goes through
+	static RomStore& shared(void);
+};
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "Runner.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include "Capture.hpp"
+#include "GdbStub.hpp"
+#include "Movie.hpp"
+#include "OpcodeException.hpp"
+#include "Rom.hpp"
+#include "Scheduler.hpp"
+#include "ThreadPool.hpp"
+
+const char* jobStatusName(JobStatus status) {
+	switch (status) {
+		case JobStatus::Completed: return "completed";
+		case JobStatus::WaitingForKey: return "waiting-for-key";
+		case JobStatus::InvalidOpcode: return "invalid-opcode";
+		case JobStatus::LoadError: return "load-error";
+		case JobStatus::Desync: return "desync";
+	}
+	return "unknown";
+}
+
+Runner::Runner(size_t threadCount) : threadCount(threadCount)
+{ }
+
+JobResult Runner::runJob(const Job &job) {
+	JobResult result = { job.romPath, JobStatus::Completed, 0, 0, 0, 0, CacheStats(), "", "" };
+	auto start = std::chrono::steady_clock::now();
+
+	// Instances are large, keep them off the worker stacks
+	std::unique_ptr<Chip8> chip8(new Chip8());
+	std::unique_ptr<Movie> movie;
+	std::unique_ptr<CaptureWriter> capture;
+	std::unique_ptr<GdbStub> debugger;
+	try {
+		chip8->setDispatch(job.dispatch);
+		chip8->setSeed(job.seed);
+#ifdef CHIP8_PROFILING
+		chip8->setProfiling(job.profile != ProfileFormat::None);
+#endif
+		chip8->loadROM(job.romPath.c_str());
+		chip8->setQuirks(job.detectQuirks ? RomStore::shared().load(job.romPath)->detectQuirks() : job.quirks);
+		if (!job.tracePath.empty()) {
+			chip8->startTrace(job.tracePath);
+		}
+		if (!job.capturePath.empty()) {
+			capture.reset(new CaptureWriter(job.capturePath));
+		}
+
+		uint32_t instructionsPerSecond = job.instructionsPerSecond;
+		if (!job.moviePath.empty()) {
+			movie.reset(new Movie());
+			movie->load(job.moviePath);
+			movie->prepare(*chip8, job.romPath.c_str());
+			instructionsPerSecond = movie->getInstructionsPerSecond();
+		}
+
+		if (job.debugPort) {
+			debugger.reset(new GdbStub(*chip8, job.debugPort));
+			debugger->accept();
+			chip8->setDebugger(debugger.get());
+		}
+
+		Scheduler scheduler(*chip8, instructionsPerSecond, ClockMode::Warp);
+		while ((job.budget.cycles == 0 || result.cycles < job.budget.cycles)
+			&& (job.budget.frames == 0 || result.frames < job.budget.frames)) {
+			// Stopped at the start, at a breakpoint or fault, or interrupted
+			if (debugger) {
+				debugger->poll();
+				if (debugger->isStopped()) {
+					DebugAction action = debugger->serve();
+					if (action == DebugAction::Kill) {
+						result.message = "killed by the debugger";
+						break;
+					}
+					if (action == DebugAction::Detach) {
+						chip8->setDebugger(nullptr);
+						debugger.reset();
+					}
+				}
+			}
+			// 00FD ends the program for good
+			if (chip8->hasExited()) {
+				result.message = "exited";
+				break;
+			}
+			if (movie) {
+				if (result.frames >= movie->getFrames()) {
+					break;
+				}
+				if (!movie->applyKeys(*chip8, result.frames)) {
+					result.status = JobStatus::Desync;
+					result.message = movie->getDesync();
+					break;
+				}
+			}
+			// Nobody will ever press a key in a headless run
+			else if (chip8->isWaitingForKey()) {
+				result.status = JobStatus::WaitingForKey;
+				break;
+			}
+
+			uint64_t limit = job.budget.cycles ? job.budget.cycles - result.cycles : UINT64_MAX;
+			uint64_t frame = result.frames;
+			result.cycles += scheduler.runFrame(limit);
+			result.frames = scheduler.getFrameCount();
+			// The screen as it is after every tick
+			if (capture && result.frames != frame) {
+				capture->append(chip8->getDisplay(), chip8->isHighRes());
+			}
+
+			if (movie && result.frames != frame && !movie->verifyFrame(result.frames, chip8->getDisplayHash())) {
+				result.status = JobStatus::Desync;
+				result.message = movie->getDesync();
+				break;
+			}
+		}
+	}
+	catch (OpCodeException &e) {
+		result.status = JobStatus::InvalidOpcode;
+		char detail[32];
+		snprintf(detail, sizeof(detail), " %04X at %03X", e.getOpCode(), e.getOffset());
+		result.message = e.getMessage() + detail;
+	}
+	catch (const std::runtime_error &error) {
+		result.status = JobStatus::LoadError;
+		result.message = error.what();
+	}
+
+	// The client learns the guest is gone
+	if (debugger) {
+		debugger->exited(result.status == JobStatus::Completed ? 0 : 1);
+	}
+
+	// Completes the trace and capture files
+	try {
+		chip8->stopTrace();
+		if (capture) {
+			capture->close();
+		}
+	}
+	catch (const std::runtime_error &error) {
+		result.message = error.what();
+	}
+	result.displayHash = chip8->getDisplayHash();
+	result.cache = chip8->getCacheStats();
+#ifdef CHIP8_PROFILING
+	if (chip8->getProfiler()) {
+		std::ostringstream profile;
+		chip8->getProfiler()->write(profile, job.profile);
+		result.profile = profile.str();
+	}
+#endif
+	result.elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	return result;
+}
+
+std::vector<JobResult> Runner::run(const std::vector<Job> &jobs) {
+	std::vector<JobResult> results(jobs.size());
+	ThreadPool pool(threadCount);
+
+	for (size_t i = 0; i < jobs.size(); i++) {
+		// Every task writes only its own slot
+		pool.submit([&jobs, &results, i] {
+			results[i] = runJob(jobs[i]);
+		});
+	}
+	pool.wait();
+
+	return results;
+}
+
+void Runner::printSummary(std::ostream &out, const std::vector<JobResult> &results, uint64_t wallNs) {
+	const int statusKinds = static_cast<int>(JobStatus::Desync) + 1;
+	uint64_t statusCount[statusKinds] = {};
+	uint64_t totalCycles = 0;
+	uint64_t totalFrames = 0;
+	CacheStats cache = CacheStats();
+
+	for (auto &result : results) {
+		out << jobStatusName(result.status)
+			<< "\t" << result.cycles
+			<< "\t" << result.frames
+			<< "\t" << result.elapsedNs / 1000 << "us"
+			<< "\t" << std::hex << result.displayHash << std::dec
+			<< "\t" << result.romPath;
+		if (!result.message.empty()) {
+			out << "\t" << result.message;
+		}
+		out << std::endl;
+
+		statusCount[static_cast<int>(result.status)]++;
+		totalCycles += result.cycles;
+		totalFrames += result.frames;
+		cache.hits += result.cache.hits;
+		cache.misses += result.cache.misses;
+		cache.invalidations += result.cache.invalidations;
+	}
+
+	double seconds = wallNs / 1e9;
+	out << std::endl << "instances: " << results.size() << std::endl;
+	for (int i = 0; i < statusKinds; i++) {
+		out << "  " << jobStatusName(static_cast<JobStatus>(i)) << ": " << statusCount[i] << std::endl;
+	}
+	out << "cycles: " << totalCycles << std::endl
+		<< "frames: " << totalFrames << std::endl
+		<< "wall time: " << seconds << "s" << std::endl
+		<< "cycles/sec: " << (seconds > 0 ? totalCycles / seconds : 0) << std::endl;
+
+	if (cache.hits + cache.misses > 0) {
+		out << "icache hits: " << cache.hits
+			<< " (" << 100.0 * cache.hits / (cache.hits + cache.misses) << "%)" << std::endl
+			<< "icache misses: " << cache.misses << std::endl
+			<< "icache invalidations: " << cache.invalidations << std::endl;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+#include "Profiler.hpp"
+
+// Execution limits of a single instance.
+// A zero limit is unlimited, at least one of them has to be set unless
+// a movie ends the run.
+struct Budget {
+	uint64_t cycles;
+	uint64_t frames; // 60 Hz timer ticks
+};
+
+struct Job {
+	std::string romPath;
+	Budget budget;
+	Dispatch dispatch;
+	uint32_t instructionsPerSecond;
+	ProfileFormat profile; // Needs a build with CHIP8_PROFILING
+	std::string tracePath; // Execution trace output, empty for none
+	uint64_t seed; // CXNN generator seed
+	std::string moviePath; // Input movie to replay, empty for none. Sets the seed, rate and quirks
+	QuirkProfile quirks;
+	bool detectQuirks; // Rom::detectQuirks picks the profile instead
+	std::string capturePath; // Every frame goes here, see CaptureWriter; empty for none
+	uint16_t debugPort; // Waits for a GDB client on this port before running, 0 for none
+};
+
+enum class JobStatus {
+	Completed,
+	WaitingForKey,
+	InvalidOpcode,
+	LoadError,
+	Desync // The replay diverged from the movie
+};
+
+struct JobResult {
+	std::string romPath;
+	JobStatus status;
+	uint64_t cycles;
+	uint64_t frames;
+	uint64_t elapsedNs;
+	uint64_t displayHash; // FNV-1a of the final screen
+	CacheStats cache;
+	std::string message;
+	std::string profile; // Rendered in the format requested by the job
+};
+
+// Runs many headless Chip8 instances on a work-stealing thread pool
+class Runner {
+private:
+	size_t threadCount;
+
+public:
+	Runner(size_t threadCount = 0);
+
+	static JobResult runJob(const Job &job);
+	std::vector<JobResult> run(const std::vector<Job> &jobs);
+	static void printSummary(std::ostream &out, const std::vector<JobResult> &results, uint64_t wallNs);
+};
+
+const char* jobStatusName(JobStatus status);
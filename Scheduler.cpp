@@ -0,0 +1,76 @@
+#include "Scheduler.hpp"
+#include <algorithm>
+#include <thread>
+
+// Ticks the real-time clock may fall behind before it gives up catching up
+#define MAX_FRAME_LAG 4
+
+Scheduler::Scheduler(Chip8 &chip8, uint32_t instructionsPerSecond, ClockMode mode)
+	: chip8(chip8), instructionsPerSecond(instructionsPerSecond), mode(mode),
+	rateRemainder(0), pending(0), tickStarted(false), frames(0),
+	deadline(std::chrono::steady_clock::now())
+{ }
+
+uint64_t Scheduler::runFrame(const uint64_t maxInstructions) {
+	if (!tickStarted) {
+		// Spread rates that are not a multiple of 60 evenly over the ticks
+		rateRemainder += instructionsPerSecond;
+		pending = rateRemainder / TIMER_HZ;
+		rateRemainder %= TIMER_HZ;
+		tickStarted = true;
+	}
+
+	uint64_t executed = chip8.run(std::min(pending, maxInstructions));
+	pending -= executed;
+
+	// A guest waiting for a key, or one that exited, idles for the rest of the tick
+	if (pending == 0 || chip8.isWaitingForKey() || chip8.hasExited()) {
+		chip8.tickTimers();
+		tickStarted = false;
+		frames++;
+	}
+
+	return executed;
+}
+
+void Scheduler::waitForNextFrame(void) {
+	if (mode == ClockMode::Warp) {
+		return;
+	}
+
+	const std::chrono::nanoseconds period(1000000000 / TIMER_HZ);
+	auto now = std::chrono::steady_clock::now();
+
+	deadline += period;
+	if (now - deadline > period * MAX_FRAME_LAG) {
+		// The host stalled (window drag, suspend), resume from now instead of bursting
+		deadline = now;
+		return;
+	}
+
+	// Sleeping to an absolute deadline keeps the average rate exact
+	std::this_thread::sleep_until(deadline);
+}
+
+void Scheduler::setInstructionsPerSecond(uint32_t instructionsPerSecond) {
+	this->instructionsPerSecond = instructionsPerSecond;
+}
+
+uint32_t Scheduler::getInstructionsPerSecond(void) {
+	return instructionsPerSecond;
+}
+
+void Scheduler::setMode(ClockMode mode) {
+	if (mode == ClockMode::RealTime && this->mode != mode) {
+		deadline = std::chrono::steady_clock::now();
+	}
+	this->mode = mode;
+}
+
+ClockMode Scheduler::getMode(void) {
+	return mode;
+}
+
+uint64_t Scheduler::getFrameCount(void) {
+	return frames;
+}
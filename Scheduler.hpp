@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "chip8.hpp"
+
+#define TIMER_HZ 60
+
+enum class ClockMode {
+	RealTime, // Sleep until every 60 Hz tick is due
+	Warp      // Run ticks back to back, as fast as the host allows
+};
+
+// Drives a Chip8 in 60 Hz ticks.
+// Every tick runs the instructions the configured rate allows for it and
+// then decrements the timers once, so guest timing does not depend on how
+// fast the host runs the loop.
+class Scheduler {
+private:
+	Chip8 &chip8;
+	uint32_t instructionsPerSecond;
+	ClockMode mode;
+
+	uint32_t rateRemainder; // Instructions per second not yet spread over ticks
+	uint64_t pending;       // Instructions left in the current tick
+	bool tickStarted;
+	uint64_t frames;
+	std::chrono::steady_clock::time_point deadline;
+
+public:
+	Scheduler(Chip8 &chip8, uint32_t instructionsPerSecond = 600, ClockMode mode = ClockMode::RealTime);
+
+	uint64_t runFrame(const uint64_t maxInstructions = UINT64_MAX);
+	void waitForNextFrame(void);
+
+	void setInstructionsPerSecond(uint32_t instructionsPerSecond);
+	uint32_t getInstructionsPerSecond(void);
+	void setMode(ClockMode mode);
+	ClockMode getMode(void);
+	uint64_t getFrameCount(void);
+};
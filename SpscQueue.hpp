@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. Neither side ever blocks or allocates: push fails when
+// the queue is full and pop when it is empty.
+// Capacity must be a power of two; the indices count up forever and are
+// masked on access.
+template <typename T, size_t Capacity>
+class SpscQueue {
+private:
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	T items[Capacity];
+	// On their own cache lines, the two threads only write their own index
+	alignas(64) std::atomic<size_t> head; // Next item to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail; // Next free slot, written by the producer
+
+public:
+	SpscQueue() : head(0), tail(0) { }
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer side
+	bool push(const T &item) {
+		const size_t slot = tail.load(std::memory_order_relaxed);
+		if (slot - head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		items[slot & (Capacity - 1)] = item;
+		tail.store(slot + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side
+	bool pop(T &item) {
+		const size_t slot = head.load(std::memory_order_relaxed);
+		if (slot == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = items[slot & (Capacity - 1)];
+		head.store(slot + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, the item pop would return without removing it
+	bool peek(T &item) {
+		const size_t slot = head.load(std::memory_order_relaxed);
+		if (slot == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = items[slot & (Capacity - 1)];
+		return true;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t threadCount) : nextWorker(0), pending(0), stopping(false) {
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0) {
+			threadCount = 1;
+		}
+	}
+
+	for (size_t i = 0; i < threadCount; i++) {
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+	for (size_t i = 0; i < threadCount; i++) {
+		threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	wait();
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void(void)> task) {
+	// Spread tasks round robin, idle workers will steal the rest
+	size_t target = nextWorker++ % workers.size();
+
+	pending++;
+	{
+		std::lock_guard<std::mutex> guard(workers[target]->lock);
+		workers[target]->tasks.push_back(std::move(task));
+	}
+	{
+		// Taking the lock orders the push with a worker about to sleep
+		std::lock_guard<std::mutex> guard(stateLock);
+	}
+	workAvailable.notify_one();
+}
+
+void ThreadPool::wait(void) {
+	std::unique_lock<std::mutex> guard(stateLock);
+	allDone.wait(guard, [this] { return pending == 0; });
+}
+
+size_t ThreadPool::size(void) const {
+	return threads.size();
+}
+
+bool ThreadPool::popTask(size_t self, std::function<void(void)> &task) {
+	{
+		// Own work is taken LIFO to keep it cache hot
+		Worker &own = *workers[self];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// Steal the oldest task of another worker
+	for (size_t i = 1; i < workers.size(); i++) {
+		Worker &victim = *workers[(self + i) % workers.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+	std::function<void(void)> task;
+
+	while (true) {
+		if (popTask(self, task)) {
+			task();
+			task = nullptr;
+
+			if (--pending == 0) {
+				std::lock_guard<std::mutex> guard(stateLock);
+				allDone.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(stateLock);
+		if (stopping) {
+			return;
+		}
+		// Recheck under the lock so a submit between popTask and here is not missed
+		workAvailable.wait(guard, [this] {
+			if (stopping) {
+				return true;
+			}
+			for (auto &worker : workers) {
+				std::lock_guard<std::mutex> workerGuard(worker->lock);
+				if (!worker->tasks.empty()) {
+					return true;
+				}
+			}
+			return false;
+		});
+	}
+}
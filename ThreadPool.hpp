@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pops its own work from the back and,
+// when empty, steals from the front of the other workers' deques.
+class ThreadPool {
+private:
+	struct Worker {
+		std::mutex lock;
+		std::deque<std::function<void(void)>> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> nextWorker;
+	std::atomic<size_t> pending;
+	bool stopping;
+
+	// Guards sleeping/waking of idle workers and of wait()
+	std::mutex stateLock;
+	std::condition_variable workAvailable;
+	std::condition_variable allDone;
+
+	bool popTask(size_t self, std::function<void(void)> &task);
+	void workerLoop(size_t self);
+
+public:
+	ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void(void)> task);
+	void wait(void);
+	size_t size(void) const;
+};
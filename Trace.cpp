@@ -0,0 +1,111 @@
+#include "Trace.hpp"
+#include <stdexcept>
+
+#ifdef CHIP8_TRACE_SUPPORTED
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Fault the pages of a chunk in while mapping it instead of once per page while recording
+#ifdef MAP_POPULATE
+#define TRACE_MAP_FLAGS MAP_POPULATE
+#else
+#define TRACE_MAP_FLAGS 0
+#endif
+
+#define TRACE_CHUNK_BYTES (static_cast<size_t>(TRACE_CHUNK_RECORDS) * sizeof(TraceRecord))
+
+TraceWriter::TraceWriter(const std::string &path) : path(path), fd(-1), chunk(nullptr), chunkIndex(0), slot(1), count(0) {
+#ifdef CHIP8_TRACE_SUPPORTED
+	fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		throw std::runtime_error("Error: cannot create trace file " + path);
+	}
+	// The destructor does not run for a writer that failed to construct
+	try {
+		mapChunk();
+	}
+	catch (...) {
+		// Only a regular file is ours to remove, the path may be a device
+		struct stat status;
+		if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode)) {
+			unlink(path.c_str());
+		}
+		::close(fd);
+		throw;
+	}
+#else
+	throw std::runtime_error("Error: tracing is not supported on this platform");
+#endif
+}
+
+TraceWriter::~TraceWriter() {
+	try {
+		close();
+	}
+	catch (const std::runtime_error &) {
+		// Chip8::stopTrace reports it, a destructor cannot
+	}
+}
+
+void TraceWriter::mapChunk(void) {
+#ifdef CHIP8_TRACE_SUPPORTED
+	off_t offset = static_cast<off_t>(chunkIndex * TRACE_CHUNK_BYTES);
+	if (ftruncate(fd, offset + TRACE_CHUNK_BYTES) != 0) {
+		throw std::runtime_error("Error: cannot grow trace file " + path);
+	}
+	void *memory = mmap(nullptr, TRACE_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | TRACE_MAP_FLAGS, fd, offset);
+	if (memory == MAP_FAILED) {
+		throw std::runtime_error("Error: cannot map trace file " + path);
+	}
+	chunk = static_cast<TraceRecord*>(memory);
+#endif
+}
+
+void TraceWriter::nextChunk(void) {
+#ifdef CHIP8_TRACE_SUPPORTED
+	munmap(chunk, TRACE_CHUNK_BYTES);
+	chunk = nullptr;
+	chunkIndex++;
+	slot = 0;
+	mapChunk();
+#endif
+}
+
+void TraceWriter::close(void) {
+#ifdef CHIP8_TRACE_SUPPORTED
+	if (fd < 0) {
+		return;
+	}
+	if (chunk) {
+		munmap(chunk, TRACE_CHUNK_BYTES);
+		chunk = nullptr;
+	}
+
+	TraceHeader header = TraceHeader();
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.recordSize = sizeof(TraceRecord);
+	header.records = count;
+	bool complete = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+
+	// Drop the unused part of the last chunk
+	complete = ftruncate(fd, sizeof(TraceHeader) + count * sizeof(TraceRecord)) == 0 && complete;
+	::close(fd);
+	fd = -1;
+
+	if (!complete) {
+		throw std::runtime_error("Error: cannot complete trace file " + path);
+	}
+#endif
+}
+
+uint64_t TraceWriter::getRecords(void) {
+	return count;
+}
+
+const std::string& TraceWriter::getPath(void) {
+	return path;
+}
\ No newline at end of file
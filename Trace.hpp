@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_TRACE_SUPPORTED
+#endif
+
+#define TRACE_MAGIC 0x54384843 // "CH8T"
+#define TRACE_VERSION 1
+
+// File header, followed by `records` TraceRecords
+struct TraceHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	uint64_t records;
+	uint8_t reserved[16];
+};
+static_assert(sizeof(TraceHeader) == 32, "TraceHeader must be 32 bytes");
+
+// One executed instruction, with the registers after it ran
+struct TraceRecord {
+	uint64_t cycle;
+	uint16_t pc;
+	uint16_t opcode;
+	uint16_t I;
+	uint16_t changed; // Bit x set when Vx was written with a new value
+	uint8_t V[16];
+};
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must be 32 bytes");
+
+// Appends records to a memory-mapped file.
+// The file is mapped one chunk of TRACE_CHUNK_RECORDS slots at a time, so
+// appending a record is a store into the mapping; only moving on to the
+// next chunk costs system calls. The header takes the first slot of the
+// first chunk and is written on close, when the file is also cut to its
+// final size.
+#define TRACE_CHUNK_RECORDS (1 << 18)
+
+class TraceWriter {
+private:
+	std::string path;
+	int fd;
+	TraceRecord *chunk; // Mapping of the current chunk
+	uint64_t chunkIndex;
+	size_t slot; // Next free slot in the chunk
+	uint64_t count;
+
+	void mapChunk(void);
+	void nextChunk(void);
+
+public:
+	TraceWriter(const std::string &path);
+	~TraceWriter();
+
+	inline void append(const uint64_t cycle, const uint16_t pc, const uint16_t opcode, const uint16_t I,
+		const uint8_t (&before)[16], const uint8_t (&V)[16]) {
+		if (slot == TRACE_CHUNK_RECORDS) {
+			nextChunk();
+		}
+
+		TraceRecord *record = chunk + slot++;
+		count++;
+		record->cycle = cycle;
+		record->pc = pc;
+		record->opcode = opcode;
+		record->I = I;
+
+		uint16_t changed = 0;
+		for (int x = 0; x < 16; x++) {
+			changed |= static_cast<uint16_t>(before[x] != V[x]) << x;
+		}
+		record->changed = changed;
+		memcpy(record->V, V, 16);
+	}
+
+	void close(void);
+	uint64_t getRecords(void);
+	const std::string& getPath(void);
+};
\ No newline at end of file
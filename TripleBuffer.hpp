@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of whole values, e.g. frames, from one producer thread
+// to one consumer thread. The producer fills the back slot and publishes
+// it, the consumer takes the newest published slot as its front; the third
+// slot sits in between. Neither side ever waits for the other, values the
+// consumer was too slow to take are replaced by newer ones.
+template <typename T>
+class TripleBuffer {
+private:
+	static const uint8_t FRESH = 0x04; // The middle slot holds a value the consumer has not taken
+
+	T slots[3];
+	alignas(64) std::atomic<uint8_t> middle; // Slot index | FRESH
+	alignas(64) uint8_t back;  // Producer only
+	alignas(64) uint8_t front; // Consumer only
+
+public:
+	TripleBuffer() : middle(1), back(0), front(2) { }
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Producer side, the slot to fill next
+	T& getBack(void) {
+		return slots[back];
+	}
+
+	// Producer side. Returns true if the value published before was never
+	// taken; it is the back slot again, so it can be merged into the next one.
+	bool publish(void) {
+		const uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+		back = previous & 0x03;
+		return (previous & FRESH) != 0;
+	}
+
+	// Consumer side. Takes the newest value, returns false if nothing was
+	// published since the last call and the front slot is unchanged.
+	bool update(void) {
+		if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+			return false;
+		}
+		const uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+		front = previous & 0x03;
+		return true;
+	}
+
+	// Consumer side
+	const T& getFront(void) {
+		return slots[front];
+	}
+};
\ No newline at end of file
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+#include "Batch.hpp"
+#include "Rom.hpp"
+
+// Throughput benchmarks of the interpreter.
+// Every case prints one JSON object per line:
+// {"bench": ..., "case": ..., "ops_per_sec": ..., "ns_per_op": ..., "p50": ..., "p90": ..., "p99": ..., ...}
+// where the percentiles are ns per operation over the samples.
+
+struct Options {
+	unsigned samples;
+	uint64_t batch;
+	std::string filter;
+};
+
+static Options options = { 50, 20000, "" };
+
+static void report(const std::string &bench, const std::string &name, std::vector<double> &nsPerOp, uint64_t opsPerSample) {
+	std::sort(nsPerOp.begin(), nsPerOp.end());
+
+	double total = 0;
+	for (double ns : nsPerOp) {
+		total += ns;
+	}
+	double mean = total / nsPerOp.size();
+	auto percentile = [&nsPerOp](double p) {
+		return nsPerOp[std::min(nsPerOp.size() - 1, static_cast<size_t>(p * nsPerOp.size()))];
+	};
+
+	printf("{\"bench\": \"%s\", \"case\": \"%s\", \"ops_per_sec\": %.0f, \"ns_per_op\": %.3f, "
+		"\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"min\": %.3f, \"samples\": %zu, \"ops_per_sample\": %llu}\n",
+		bench.c_str(), name.c_str(), 1e9 / mean, mean,
+		percentile(0.5), percentile(0.9), percentile(0.99), nsPerOp.front(),
+		nsPerOp.size(), static_cast<unsigned long long>(opsPerSample));
+	fflush(stdout);
+}
+
+// Times `samples` runs of sample(), which performs opsPerSample operations.
+// setup() runs untimed before every sample.
+static void measure(const std::string &bench, const std::string &name, uint64_t opsPerSample,
+	std::function<void(void)> setup, std::function<void(void)> sample) {
+	if (!options.filter.empty() && (bench + "/" + name).find(options.filter) == std::string::npos) {
+		return;
+	}
+
+	std::vector<double> nsPerOp;
+	// One untimed warm-up sample
+	setup();
+	sample();
+
+	for (unsigned i = 0; i < options.samples; i++) {
+		setup();
+		auto start = std::chrono::steady_clock::now();
+		sample();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		nsPerOp.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / opsPerSample);
+	}
+
+	report(bench, name, nsPerOp, opsPerSample);
+}
+
+static std::string tempPath(const std::string &name) {
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// A fresh machine with small register values, I at a scratch area
+static std::unique_ptr<Chip8> makeMachine(void) {
+	std::unique_ptr<Chip8> chip8(new Chip8());
+	for (uint16_t x = 0; x < 16; x++) {
+		chip8->decodeOpCode(0x6000 | x << 8 | (x + 1));
+	}
+	chip8->decodeOpCode(0xA300);
+	return chip8;
+}
+
+static void benchDecode(void) {
+	// Representative opcode of every class whose execution can be repeated
+	// without leaving memory or the stack
+	struct Case { const char *name; std::vector<uint16_t> opcodes; };
+	const Case cases[] = {
+		{ "00E0", { 0x00E0 } },
+		{ "2NNN+00EE", { 0x2400, 0x00EE } },
+		{ "1NNN", { 0x1400 } },
+		{ "3XNN", { 0x3105 } },
+		{ "4XNN", { 0x4105 } },
+		{ "5XY0", { 0x5120 } },
+		{ "6XNN", { 0x6142 } },
+		{ "7XNN", { 0x7101 } },
+		{ "8XY0", { 0x8120 } },
+		{ "8XY1", { 0x8121 } },
+		{ "8XY2", { 0x8122 } },
+		{ "8XY3", { 0x8123 } },
+		{ "8XY4", { 0x8124 } },
+		{ "8XY5", { 0x8125 } },
+		{ "8XY6", { 0x8126 } },
+		{ "8XY7", { 0x8127 } },
+		{ "8XYE", { 0x812E } },
+		{ "9XY0", { 0x9120 } },
+		{ "ANNN", { 0xA300 } },
+		{ "BNNN", { 0xB400 } },
+		{ "CXNN", { 0xC1FF } },
+		{ "DXYN", { 0xD125 } },
+		{ "EX9E", { 0xE19E } },
+		{ "EXA1", { 0xE1A1 } },
+		{ "FX07", { 0xF107 } },
+		{ "FX15", { 0xF115 } },
+		{ "FX18", { 0xF118 } },
+		{ "FX1E", { 0xF01E } },
+		{ "FX29", { 0xF129 } },
+		{ "FX33", { 0xF133, 0xA300 } },
+		{ "FX55", { 0xF755, 0xA300 } },
+		{ "FX65", { 0xF765, 0xA300 } },
+		{ "00CN", { 0x00C1 } },
+		{ "00FB", { 0x00FB } },
+		{ "00FC", { 0x00FC } },
+		{ "DXY0", { 0xD120 } },
+		{ "FX30", { 0xF130 } },
+		{ "FX75", { 0xF775 } },
+		{ "FX85", { 0xF785 } },
+	};
+
+	std::unique_ptr<Chip8> chip8;
+	for (auto &c : cases) {
+		const std::vector<uint16_t> &opcodes = c.opcodes;
+		uint64_t rounds = options.batch / opcodes.size();
+
+		measure("decode", c.name, rounds * opcodes.size(),
+			[&chip8] { chip8 = makeMachine(); },
+			[&chip8, &opcodes, rounds] {
+				for (uint64_t i = 0; i < rounds; i++) {
+					for (auto opcode : opcodes) {
+						chip8->decodeOpCode(opcode);
+					}
+				}
+			});
+	}
+}
+
+static void benchSprites(void) {
+	std::unique_ptr<Chip8> chip8;
+
+	// Both display modes, 00FE and 00FF select them
+	for (uint16_t mode : { 0x00FE, 0x00FF }) {
+		const std::string suffix = mode == 0x00FF ? "/hires" : "";
+		for (uint16_t height = 0; height <= 15; height++) {
+			// Sprite rows come from the font data at address 0, x moves every draw.
+			// Height 0 is the 16x16 sprite of DXY0.
+			uint16_t draw = 0xD120 | height;
+			measure("sprite", (height ? "DXYN/n=" + std::to_string(height) : std::string("DXY0")) + suffix, options.batch,
+				[&chip8, mode] { chip8 = makeMachine(); chip8->decodeOpCode(mode); chip8->decodeOpCode(0xA000); },
+				[&chip8, draw] {
+					for (uint64_t i = 0; i < options.batch; i++) {
+						chip8->decodeOpCode(draw);
+						chip8->decodeOpCode(0x7103);
+					}
+				});
+		}
+	}
+}
+
+// Synthetic ROMs exercising one kind of workload each
+struct SyntheticRom {
+	const char *name;
+	std::vector<uint8_t> bytes;
+};
+
+static std::vector<SyntheticRom> syntheticRoms(void) {
+	return {
+		{ "alu", {
+			0x60, 0x00, 0x61, 0x01, 0x62, 0x07, // 200: V0 = 0, V1 = 1, V2 = 7
+			0x70, 0x01, 0x83, 0x04, 0x84, 0x25, // 206: V0 += 1, V3 += V0, V4 -= V2
+			0x85, 0x36, 0x86, 0x4E, 0x87, 0x51, // 20C: shifts and or
+			0x88, 0x62, 0x89, 0x73, 0x8A, 0x87, // 212: and, xor, subn
+			0x30, 0xFF, 0x12, 0x06,             // 218: loop until V0 == 0xFF
+			0x12, 0x00                          // 21C: restart
+		} },
+		{ "draw", {
+			0x00, 0xE0, 0x60, 0x00, 0x61, 0x00, // 200: cls, V0 = V1 = 0
+			0xF2, 0x29, 0xD0, 0x15,             // 206: I = font(V2), draw 5 rows at V0, V1
+			0x70, 0x05, 0x72, 0x01,             // 20A: next column and digit
+			0x30, 0x3C, 0x12, 0x06,             // 20E: until the row is full
+			0x71, 0x06, 0x60, 0x00,             // 212: next row
+			0x31, 0x1E, 0x12, 0x06,             // 216: until the screen is full
+			0x12, 0x00                          // 21A: restart
+		} },
+		{ "calls", {
+			0x22, 0x08, 0x22, 0x0C,             // 200: call 208, call 20C
+			0x12, 0x00, 0x00, 0x00,             // 204: loop
+			0x70, 0x01, 0x00, 0xEE,             // 208: V0 += 1, return
+			0x22, 0x08, 0x71, 0x01, 0x00, 0xEE  // 20C: nested call, V1 += 1, return
+		} },
+		{ "memory", {
+			0xA3, 0x00, 0x70, 0x07,             // 200: I = 300, V0 += 7
+			0xF0, 0x33, 0xF2, 0x65,             // 204: BCD of V0, load V0..V2
+			0x80, 0x24, 0xF3, 0x55,             // 208: V0 += V2, store V0..V3
+			0x75, 0x01, 0x12, 0x00              // 20C: count, restart
+		} },
+	};
+}
+
+static void benchCycles(void) {
+	const struct { const char *name; Dispatch dispatch; } cores[] = {
+		{ "switch", Dispatch::Switch },
+		{ "table", Dispatch::Table },
+		{ "cached", Dispatch::Cached },
+		{ "jit", Dispatch::Jit },
+	};
+
+	std::unique_ptr<Chip8> chip8;
+	for (auto &rom : syntheticRoms()) {
+		// Written once, loaded before every sample
+		std::string path = tempPath(std::string("chip8_bench_") + rom.name + ".ch8");
+		std::ofstream(path, std::ios::binary).write((const char*)rom.bytes.data(), rom.bytes.size());
+
+		for (auto &core : cores) {
+			uint64_t cycles = options.batch * 10;
+			measure("cycles", std::string(rom.name) + "/" + core.name, cycles,
+				[&chip8, &path, &core] {
+					chip8.reset(new Chip8());
+					chip8->setDispatch(core.dispatch);
+					chip8->loadROM(path.c_str());
+				},
+				[&chip8, cycles] { chip8->run(cycles); });
+		}
+
+		std::remove(path.c_str());
+	}
+}
+
+// Every profile has its own handlers, none should cost more than the others
+static void benchQuirks(void) {
+	const struct { const char *name; Dispatch dispatch; } cores[] = {
+		{ "table", Dispatch::Table },
+		{ "jit", Dispatch::Jit },
+	};
+
+	std::unique_ptr<Chip8> chip8;
+	for (auto &rom : syntheticRoms()) {
+		std::string path = tempPath(std::string("chip8_bench_") + rom.name + ".ch8");
+		std::ofstream(path, std::ios::binary).write((const char*)rom.bytes.data(), rom.bytes.size());
+
+		for (auto &core : cores) {
+			for (uint8_t profile = 0; profile < static_cast<uint8_t>(QuirkProfile::Count); profile++) {
+				QuirkProfile quirks = static_cast<QuirkProfile>(profile);
+				uint64_t cycles = options.batch * 10;
+				measure("quirks", std::string(rom.name) + "/" + core.name + "/" + quirkProfileName(quirks), cycles,
+					[&chip8, &path, &core, quirks] {
+						chip8.reset(new Chip8());
+						chip8->setDispatch(core.dispatch);
+						chip8->setQuirks(quirks);
+						chip8->loadROM(path.c_str());
+					},
+					[&chip8, cycles] { chip8->run(cycles); });
+			}
+		}
+
+		std::remove(path.c_str());
+	}
+}
+
+// The same ROM on many machines: separate objects against one lockstep batch
+static void benchBatch(void) {
+	const size_t lanes = 256;
+	const uint64_t steps = std::max<uint64_t>(options.batch / lanes * 10, 1);
+
+	std::vector<std::unique_ptr<Chip8>> machines;
+	std::unique_ptr<Batch> batch;
+	for (auto &rom : syntheticRoms()) {
+		std::string path = tempPath(std::string("chip8_bench_") + rom.name + ".ch8");
+		std::ofstream(path, std::ios::binary).write((const char*)rom.bytes.data(), rom.bytes.size());
+
+		measure("batch", std::string(rom.name) + "/objects", lanes * steps,
+			[&machines, &path, lanes] {
+				machines.clear();
+				for (size_t i = 0; i < lanes; i++) {
+					machines.emplace_back(new Chip8());
+					machines.back()->loadROM(path.c_str());
+				}
+			},
+			[&machines, steps] {
+				for (auto &chip8 : machines) {
+					chip8->run(steps);
+				}
+			});
+		measure("batch", std::string(rom.name) + "/lanes", lanes * steps,
+			[&batch, &path, lanes] {
+				batch.reset(new Batch(lanes));
+				batch->loadROM(path.c_str());
+			},
+			[&batch, steps] { batch->run(steps); });
+
+		std::remove(path.c_str());
+	}
+}
+
+// Loading through the shared store, and reading and validating a file afresh
+static void benchLoad(void) {
+	for (size_t size : { static_cast<size_t>(0xFF), static_cast<size_t>(ROM_MAX_SIZE) }) {
+		std::string path = tempPath("chip8_bench_load.ch8");
+		std::vector<uint8_t> bytes(size);
+		for (size_t i = 0; i < bytes.size(); i++) {
+			bytes[i] = static_cast<uint8_t>(i * 37);
+		}
+		std::ofstream(path, std::ios::binary).write((const char*)bytes.data(), bytes.size());
+
+		std::unique_ptr<Chip8> chip8(new Chip8());
+		uint64_t loads = options.batch / 100;
+		std::string suffix = "/" + std::to_string(size) + "B";
+		measure("load", "loadROM" + suffix, loads,
+			[] { },
+			[&chip8, &path, loads] {
+				for (uint64_t i = 0; i < loads; i++) {
+					chip8->loadROM(path.c_str());
+				}
+			});
+		measure("load", "cold" + suffix, loads,
+			[] { },
+			[&path, loads] {
+				for (uint64_t i = 0; i < loads; i++) {
+					RomStore store;
+					store.load(path);
+				}
+			});
+
+		std::remove(path.c_str());
+	}
+}
+
+int main(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			options.samples = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+			options.batch = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+			options.filter = argv[++i];
+		}
+		else {
+			std::cerr << "usage: chip8_bench [-s samples] [-b batch] [-f filter]" << std::endl;
+			return 2;
+		}
+	}
+	if (options.samples == 0 || options.batch < 100) {
+		std::cerr << "Error: need at least one sample and a batch of 100" << std::endl;
+		return 2;
+	}
+
+	benchDecode();
+	benchSprites();
+	benchCycles();
+	benchQuirks();
+	benchBatch();
+	benchLoad();
+
+	return 0;
+}
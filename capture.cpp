@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "Capture.hpp"
+
+// Decodes screen captures written by chip8_headless -v
+
+static void usage(void) {
+	std::cerr << "usage: chip8_capture [options] capture_file" << std::endl
+		<< "  -f first[-last]  frame or frame range (default: all frames)" << std::endl
+		<< "  -a               draw the frames as text instead of printing their hashes" << std::endl
+		<< "  -o path          write the last selected frame as a PBM image" << std::endl
+		<< "  -s               only print a summary of the file" << std::endl;
+}
+
+// Parses "first" or "first-last"
+static bool parseRange(const char *text, uint64_t &first, uint64_t &last) {
+	char *end;
+	first = strtoull(text, &end, 10);
+	if (end == text) {
+		return false;
+	}
+	last = first;
+	if (*end == '-') {
+		const char *start = end + 1;
+		last = strtoull(start, &end, 10);
+		if (end == start) {
+			return false;
+		}
+	}
+	return *end == '\0' && first <= last;
+}
+
+template <typename G>
+static void drawText(const uint64_t *words) {
+	std::string line;
+	for (unsigned y = 0; y < G::height; y++) {
+		line.clear();
+		for (unsigned x = 0; x < G::width; x++) {
+			line += getPixel<G>(words, x, y) ? '#' : '.';
+		}
+		printf("%s\n", line.c_str());
+	}
+}
+
+template <typename G>
+static bool writePbm(const char *path, const uint64_t *words) {
+	std::ofstream out(path, std::ios::binary);
+	out << "P1\n" << G::width << " " << G::height << "\n";
+	for (unsigned y = 0; y < G::height; y++) {
+		for (unsigned x = 0; x < G::width; x++) {
+			out << (getPixel<G>(words, x, y) ? '1' : '0');
+		}
+		out << "\n";
+	}
+	return out.good();
+}
+
+int main(int argc, char* argv[]) {
+	uint64_t first = 0, last = UINT64_MAX;
+	bool text = false;
+	bool summary = false;
+	const char *imagePath = nullptr;
+	const char *path = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(arg, "-f") && hasValue) {
+			if (!parseRange(argv[++i], first, last)) {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-a")) {
+			text = true;
+		}
+		else if (!strcmp(arg, "-o") && hasValue) {
+			imagePath = argv[++i];
+		}
+		else if (!strcmp(arg, "-s")) {
+			summary = true;
+		}
+		else if (arg[0] == '-' || path) {
+			usage();
+			return 2;
+		}
+		else {
+			path = arg;
+		}
+	}
+	if (!path) {
+		usage();
+		return 2;
+	}
+
+	try {
+		CaptureReader reader(path);
+		if (summary) {
+			printf("frames: %u\nkeyframes: %u\ndelta bytes: %llu (%.1f per frame)\n",
+				reader.getFrames(), reader.getKeyframes(),
+				static_cast<unsigned long long>(reader.getDeltaBytes()),
+				reader.getFrames() ? static_cast<double>(reader.getDeltaBytes()) / reader.getFrames() : 0.0);
+			return 0;
+		}
+
+		if (first >= reader.getFrames()) {
+			std::cerr << "Error: " << path << " has " << reader.getFrames() << " frames" << std::endl;
+			return 1;
+		}
+		if (last >= reader.getFrames()) {
+			last = reader.getFrames() - 1;
+		}
+
+		// Frames are decoded forward from the keyframe before `first`
+		for (uint64_t frame = first; frame <= last; frame++) {
+			reader.seek(static_cast<uint32_t>(frame));
+			if (text) {
+				printf("frame %llu%s\n", static_cast<unsigned long long>(frame), reader.isHighRes() ? " (hi-res)" : "");
+				if (reader.isHighRes()) {
+					drawText<HighRes>(reader.getDisplay());
+				}
+				else {
+					drawText<LowRes>(reader.getDisplay());
+				}
+			}
+			else {
+				printf("%8llu  %016llx\n", static_cast<unsigned long long>(frame),
+					static_cast<unsigned long long>(reader.getDisplayHash()));
+			}
+		}
+
+		if (imagePath) {
+			bool written = reader.isHighRes() ? writePbm<HighRes>(imagePath, reader.getDisplay())
+				: writePbm<LowRes>(imagePath, reader.getDisplay());
+			if (!written) {
+				std::cerr << "Error: cannot write " << imagePath << std::endl;
+				return 1;
+			}
+		}
+	}
+	catch (const std::runtime_error &error) {
+		std::cerr << error.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -1,8 +1,16 @@
 #include "chip8.hpp"
 #include <cstdlib>
 #include <algorithm>
-#include <fstream>
+#include <cstring>
+#include <stdexcept>
 #include "OpcodeException.hpp"
+#include "Rom.hpp"
+#include "GdbStub.hpp"
+#include "Jit.hpp"
+#include "Trace.hpp"
+#ifdef CHIP8_PROFILING
+#include "Profiler.hpp"
+#endif
 
 uint8_t chip8_fontset[80] =
 {
@@ -24,6 +32,27 @@ uint8_t chip8_fontset[80] =
     0xF0, 0x80, 0xF0, 0x80, 0x80  //F
 };
 
+// SUPER-CHIP 8x10 digits, A-F as in XO-CHIP
+uint8_t chip8_bigfontset[160] =
+{
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, //0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, //1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, //4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, //6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, //7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, //8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, //A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, //B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, //C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, //D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  //F
+};
+
 Chip8::Chip8() {
     this->pc = 0x200;
     this->opcode = 0;
@@ -31,17 +60,39 @@ Chip8::Chip8() {
     this->sp = -1;
     this->delayTimer = 0;
     this->soundTimer = 0;
-    this->playSound = NULL;
-    this->sound = NULL;
+    this->soundQueue = nullptr;
+    this->debugger = nullptr;
+    this->soundOn = false;
+    this->timerTicks = 0;
+    this->tickCycle = 0;
     this->isRunning = true;
     this->waitForKey = false;
     this->drawFlag = false;
+    this->dirtyRows = 0;
+    this->highRes = false;
+    this->exited = false;
+    this->quirks = QuirkProfile::Legacy;
+    this->table = decodeTable(false, quirks);
+    this->dispatch = Dispatch::Switch;
+    this->cacheStats = CacheStats();
+    this->cycleCount = 0;
+    this->drawCalls = 0;
+    this->frameDrawn = false;
+    this->drawFrames = 0;
+    this->keyWaitTicks = 0;
+    this->fault = Fault::None;
+    this->seed = RNG_DEFAULT_SEED;
+    this->rngState = rngSeed(RNG_DEFAULT_SEED);
 
     std::fill_n(memory, 4096, 0); // Clear memory
     std::fill_n(V, 16, 0); // Clear registers
     std::fill_n(stack, 16, 0); // Clear stack
-    std::fill_n(pixels, RES, 0); // Clear display
+    std::fill_n(display, DISPLAY_WORDS, 0); // Clear display
     std::fill_n(keys, 16, false); // Clear keys array
+    std::fill_n(userFlags, 16, 0);
+    std::fill_n(keyTags, 16, 0);
+    seenTag = 0;
+    drawnTag = 0;
 
     // Load fontset
     //*memory = *(uint64_t*)chip8_fontset;
@@ -49,53 +100,323 @@ Chip8::Chip8() {
     for (int i = 0; i < 80; i++) {
        memory[i] = chip8_fontset[i];
     }
+    memcpy(memory + BIG_FONT_ADDRESS, chip8_bigfontset, sizeof(chip8_bigfontset));
+}
+
+Chip8::~Chip8() {
+}
+
+const char* faultName(const Fault fault) {
+    switch (fault) {
+        case Fault::None: return "No fault";
+        case Fault::InvalidOpcode: return "Invalid opcode";
+        case Fault::StackOverflow: return "Stack overflow";
+        case Fault::StackUnderflow: return "Stack underflow";
+        case Fault::MemoryOutOfBounds: return "Memory access out of bounds";
+        case Fault::KeyOutOfRange: return "Key out of range";
+    }
+    return "Unknown fault";
 }
 
 void Chip8::emulateCycle(void) {
+    fault = Fault::None;
+    if (!step()) {
+        throw OpCodeException(faultName(fault), opcode, pc);
+    }
+}
+
+bool Chip8::step(void) {
     // If the execution is not halted
     if (isRunning) {
-        // Fetch opcode
-        opcode = memory[pc] << 8 | memory[pc + 1];
+        const uint16_t address = pc;
+        // The fetch reads two bytes
+        if (pc > 4094) {
+            fault = Fault::MemoryOutOfBounds;
+            return false;
+        }
+        uint8_t before[16];
+        if (trace) {
+            memcpy(before, V, 16);
+        }
 
-        if (!decodeOpCode(opcode)) {
-            throw OpCodeException(opcode, (uint8_t)memory + pc);
+        bool valid;
+        if (dispatch == Dispatch::Cached && pc < 4095) {
+            const Instruction *&entry = icache[pc];
+            if (entry) {
+                cacheStats.hits++;
+            }
+            else {
+                cacheStats.misses++;
+                entry = &table[memory[pc] << 8 | memory[pc + 1]];
+            }
+            // The table is indexed by opcode
+            opcode = static_cast<uint16_t>(entry - table);
+            valid = entry->execute(*this, *entry);
+        }
+        else if (dispatch != Dispatch::Switch) {
+            // Fetch opcode
+            opcode = memory[pc] << 8 | memory[pc + 1];
+            const Instruction &instr = table[opcode];
+            valid = instr.execute(*this, instr);
         }
         else {
-            if (delayTimer > 0) {
-                delayTimer--;
+            // Fetch opcode
+            opcode = memory[pc] << 8 | memory[pc + 1];
+            valid = decodeOpCode(opcode);
+        }
+
+        // A faulted instruction did not retire, it is neither profiled nor traced
+        if (!valid) {
+            // Handlers only set the other faults
+            if (fault == Fault::None) {
+                fault = Fault::InvalidOpcode;
             }
-            if (soundTimer > 0) {
-                if (soundTimer == 1) {
-                    if (playSound) {
-                        // If a sound implementation was provided
-                        playSound(sound);
-                    }
-                }
-                soundTimer--;
+            return false;
+        }
+
+#ifdef CHIP8_PROFILING
+        if (profiler) {
+            profiler->instruction(address, opcode);
+            if (waitForKey) {
+                profiler->beginWait();
             }
         }
+#endif
+
+        if (trace) {
+            trace->append(cycleCount, address, opcode, I, before, V);
+        }
+        cycleCount++;
+    }
+    return true;
+}
+
+uint64_t Chip8::run(const uint64_t cycles) {
+    const uint64_t executed = runUntilFault(cycles);
+    if (fault != Fault::None) {
+        throw OpCodeException(faultName(fault), opcode, pc);
+    }
+    return executed;
+}
+
+uint64_t Chip8::runUntilFault(const uint64_t cycles) {
+    fault = Fault::None;
+    // Undebugged runs carry no breakpoint checks at all
+    return debugger ? runLoop<true>(cycles) : runLoop<false>(cycles);
+}
+
+template <bool Debugging>
+uint64_t Chip8::runLoop(const uint64_t cycles) {
+    uint64_t executed = 0;
+
+    while (executed < cycles && isRunning) {
+        if (Debugging && debugger->breakBefore()) {
+            break;
+        }
+
+        // Only FX07 starts an idle loop. A debugger sees every instruction.
+        if (!Debugging && pc < 4090 && memory[pc + 1] == 0x07) {
+            const uint64_t skipped = skipIdleLoop(cycles - executed);
+            if (skipped) {
+                executed += skipped;
+                continue;
+            }
+        }
+
+#ifdef CHIP8_PROFILING
+        // Instructions inside translated blocks would not be profiled or traced
+        const bool useJit = !Debugging && jit && dispatch == Dispatch::Jit && !profiler && !trace;
+#else
+        const bool useJit = !Debugging && jit && dispatch == Dispatch::Jit && !trace;
+#endif
+        if (useJit) {
+            const JitBlock *block = jit->lookup(pc, memory);
+            // A block retires all its instructions at once, never overshoot the budget
+            if (block && block->length <= cycles - executed) {
+                pc = block->code(V, &I);
+                opcode = block->lastOpcode;
+                jit->countExecution();
+                executed += block->length;
+                cycleCount += block->length;
+                continue;
+            }
+        }
+
+        if (!step()) {
+            // The debugger stops at the faulting instruction, nothing is thrown
+            if (Debugging) {
+                debugger->faulted(fault);
+                fault = Fault::None;
+            }
+            break;
+        }
+        executed++;
+
+        if (Debugging && debugger->breakAfter()) {
+            break;
+        }
+    }
+
+    return executed;
+}
+
+Fault Chip8::getFault(void) {
+    return fault;
+}
+
+uint64_t Chip8::skipIdleLoop(const uint64_t budget) {
+    // Every instruction has to show up in a trace or a profile
+#ifdef CHIP8_PROFILING
+    if (trace || profiler) {
+        return 0;
+    }
+#else
+    if (trace) {
+        return 0;
+    }
+#endif
+
+    // FX07, 3XNN, 1NNN back to the FX07: waits for the delay timer to reach NN.
+    // The timer only changes between ticks, until then every round retires
+    // the same three instructions and leaves VX at the timer.
+    const uint8_t x = memory[pc] & 0x0F;
+    if ((memory[pc] & 0xF0) != 0xF0 || memory[pc + 2] != (0x30 | x) || memory[pc + 3] == delayTimer
+        || memory[pc + 4] != (0x10 | pc >> 8) || memory[pc + 5] != (pc & 0xFF)) {
+        return 0;
+    }
+
+    // Whole rounds only, a partial one is run normally and ends where it would have
+    const uint64_t rounds = budget / 3;
+    if (rounds == 0) {
+        return 0;
+    }
+    V[x] = delayTimer;
+    opcode = 0x1000 | pc;
+    cycleCount += rounds * 3;
+    return rounds * 3;
+}
+
+void Chip8::tickTimers(void) {
+    // Called at 60 Hz, independently of the instruction rate
+#ifdef CHIP8_PROFILING
+    if (profiler) {
+        profiler->frame(waitForKey);
+    }
+#endif
+    if (delayTimer > 0) {
+        delayTimer--;
+    }
+    timerTicks++;
+    tickCycle = cycleCount;
+    drawFrames += frameDrawn;
+    frameDrawn = false;
+    keyWaitTicks += waitForKey;
+    if (soundTimer > 0) {
+        soundTimer--;
+        // The beep ends exactly on this tick
+        if (soundTimer == 0) {
+            updateSound();
+        }
+    }
+}
+
+void Chip8::updateSound(void) {
+    // Only edges are published, FX18 rewriting a running timer is not one
+    const bool on = soundTimer > 0;
+    if (on != soundOn) {
+        soundOn = on;
+        if (soundQueue) {
+            // A full queue means nobody is listening, the edge is dropped
+            soundQueue->push({ timerTicks, static_cast<uint32_t>(cycleCount - tickCycle), on });
+        }
     }
 }
 
-void Chip8::keyPress(const uint8_t key) {
+void Chip8::keyPress(const uint8_t pressed, const uint32_t tag) {
+    // Movies and other callers can hand over anything, there are 16 keys
+    const uint8_t key = pressed & 0x0F;
+    if (tag) {
+        keyTags[key] = tag;
+    }
     if (waitForKey) {
         waitForKey = false;
         isRunning = true;
+#ifdef CHIP8_PROFILING
+        if (profiler) {
+            profiler->endWait();
+        }
+#endif
 
         // Stores pressed key is VX cause of opcodes 0xEX9E and 0xEXA1
         V[opcode >> 8 & 0x0F] = key;
+        // FX0A reads the key right here
+        readKey(key);
     }
     keys[key] = true;
 }
 
 void Chip8::keyRelease(const uint8_t key) {
-    keys[key] = false;
+    keys[key & 0x0F] = false;
 }
 
-uint8_t (&Chip8::getPixels(void))[RES]
+const uint64_t (&Chip8::getDisplay(void))[DISPLAY_WORDS]
 {
     // Return a reference of the array
-    return pixels;
+    return display;
+}
+
+bool Chip8::isHighRes(void) {
+    return highRes;
+}
+
+unsigned Chip8::getDisplayWidth(void) {
+    return highRes ? HighRes::width : LowRes::width;
+}
+
+unsigned Chip8::getDisplayHeight(void) {
+    return highRes ? HighRes::height : LowRes::height;
+}
+
+uint64_t Chip8::getDisplayHash(void) {
+    // Only the words of the current mode, low resolution hashes stay comparable
+    return highRes ? hashDisplay<HighRes>(display) : hashDisplay<LowRes>(display);
+}
+
+void Chip8::getPixels(uint8_t (&pixels)[RES]) {
+    // One byte per pixel, for frontends that do not read the packed rows.
+    // Rows are getDisplayWidth() pixels apart.
+    for (unsigned y = 0; y < getDisplayHeight(); y++) {
+        for (unsigned x = 0; x < getDisplayWidth(); x++) {
+            pixels[y * getDisplayWidth() + x] = highRes ? getPixel<HighRes>(display, x, y) : getPixel<LowRes>(display, x, y);
+        }
+    }
+}
+
+void Chip8::setDisplayMode(const bool highRes) {
+    // Switching modes starts from a blank screen
+    this->highRes = highRes;
+    std::fill_n(display, DISPLAY_WORDS, 0);
+    dirtyRows = highRes ? allRows<HighRes>() : allRows<LowRes>();
+    drawFlag = true;
+    frameDrawn = true;
+
+    // Cached entries point into the table of the old mode
+    table = decodeTable(highRes, quirks);
+    if (icache) {
+        std::fill_n(icache.get(), 4096, nullptr);
+    }
+}
+
+uint64_t Chip8::takeDirtyRows(void) {
+    uint64_t rows = dirtyRows;
+    dirtyRows = 0;
+    return rows;
+}
+
+uint32_t Chip8::takeInputTag(void) {
+    uint32_t tag = drawnTag;
+    drawnTag = 0;
+    return tag;
 }
 
 bool Chip8::getDrawFlag(void) {
@@ -106,45 +427,306 @@ void Chip8::setDrawFlag(bool flag) {
     drawFlag = flag;
 }
 
+bool Chip8::isWaitingForKey(void) {
+    return waitForKey;
+}
+
+bool Chip8::hasExited(void) {
+    return exited;
+}
+
 void Chip8::loadROM(const char* fName) {
-    std::ifstream rom;
-    rom.open(fName, std::ios::binary);
+    // The file is read and validated once per process, see RomStore
+    loadROM(*RomStore::shared().load(fName));
+}
+
+void Chip8::loadROM(const Rom &rom) {
+    loadProgram(rom.getData(), rom.getSize());
+}
+
+void Chip8::loadProgram(const uint8_t *data, const size_t size) {
+    const size_t length = std::min<size_t>(size, ROM_MAX_SIZE);
+    memcpy(memory + ROM_START, data, length);
+    invalidateCode(ROM_START, static_cast<uint16_t>(length));
+}
+
+void Chip8::setSoundQueue(SoundQueue *queue) {
+    // The emulator stays independent of any audio library, the frontend
+    // consumes the edges on its own thread
+    this->soundQueue = queue;
+}
+
+void Chip8::setDispatch(Dispatch dispatch) {
+    this->dispatch = dispatch;
+
+    if (dispatch == Dispatch::Cached && !icache) {
+        icache.reset(new const Instruction*[4096]());
+    }
+    if (dispatch == Dispatch::Jit && !jit) {
+        jit.reset(new Jit());
+        jit->setQuirks(quirks);
+    }
+}
+
+void Chip8::setDebugger(GdbStub *debugger) {
+    this->debugger = debugger;
+}
+
+Dispatch Chip8::getDispatch(void) {
+    return dispatch;
+}
 
-    if (rom.fail()) {
-        throw std::runtime_error("Error: file");
+CacheStats Chip8::getCacheStats(void) {
+    return cacheStats;
+}
+
+bool Chip8::isJitAvailable(void) {
+    return jit && jit->isAvailable();
+}
+
+void Chip8::setSeed(const uint64_t seed) {
+    // Restarts the sequence of random numbers
+    this->seed = seed;
+    this->rngState = rngSeed(seed);
+}
+
+uint64_t Chip8::getSeed(void) {
+    return seed;
+}
+
+void Chip8::setQuirks(const QuirkProfile quirks) {
+    // Selects the handlers instantiated for the profile, see dispatch.cpp
+    this->quirks = quirks;
+    table = decodeTable(highRes, quirks);
+    if (icache) {
+        std::fill_n(icache.get(), 4096, nullptr);
     }
-    
-    rom.seekg(0, rom.end);
-    uint8_t length = rom.tellg();
-    rom.seekg(0, rom.beg);
+    if (jit) {
+        jit->setQuirks(quirks);
+    }
+}
 
-    rom.read((char*)(memory + 0x200), length);
+QuirkProfile Chip8::getQuirks(void) {
+    return quirks;
+}
 
-    rom.close();
+void Chip8::startTrace(const std::string &path) {
+    trace.reset();
+    trace.reset(new TraceWriter(path));
 }
 
-void Chip8::setSound(void (*func)(void *sound), void *sound) {
-    // Make sound a void pointer so the emulator implementation
-    // is not library dependend
-    this->playSound = func;
-    this->sound = sound;
+void Chip8::stopTrace(void) {
+    if (trace) {
+        std::unique_ptr<TraceWriter> finished(std::move(trace));
+        finished->close();
+    }
+}
+
+Metrics Chip8::getMetrics(void) {
+    return { cycleCount, timerTicks, drawFrames, drawCalls, keyWaitTicks };
+}
+
+uint64_t Chip8::getCycles(void) {
+    return cycleCount;
+}
+
+#ifdef CHIP8_PROFILING
+void Chip8::setProfiling(bool enabled) {
+    if (enabled && !profiler) {
+        profiler.reset(new Profiler());
+    }
+    else if (!enabled) {
+        profiler.reset();
+    }
+}
+
+Profiler* Chip8::getProfiler(void) {
+    return profiler.get();
+}
+#endif
+
+void Chip8::saveState(Snapshot &snapshot) {
+    snapshot.version = SNAPSHOT_VERSION;
+    snapshot.opcode = opcode;
+    snapshot.I = I;
+    snapshot.pc = pc;
+    memcpy(snapshot.stack, stack, sizeof(stack));
+    snapshot.sp = sp;
+    snapshot.delayTimer = delayTimer;
+    snapshot.soundTimer = soundTimer;
+    snapshot.flags = (waitForKey ? SNAPSHOT_WAIT_FOR_KEY : 0)
+        | (isRunning ? SNAPSHOT_RUNNING : 0)
+        | (drawFlag ? SNAPSHOT_DRAW : 0)
+        | (highRes ? SNAPSHOT_HIGH_RES : 0)
+        | (exited ? SNAPSHOT_EXITED : 0);
+    memcpy(snapshot.V, V, sizeof(V));
+    memcpy(snapshot.keys, keys, sizeof(keys));
+    snapshot.quirks = static_cast<uint8_t>(quirks);
+    snapshot.reserved = 0;
+    snapshot.seed = seed;
+    snapshot.rngState = rngState;
+    memcpy(snapshot.userFlags, userFlags, sizeof(userFlags));
+    memcpy(snapshot.display, display, sizeof(display));
+    memcpy(snapshot.memory, memory, sizeof(memory));
+}
+
+void Chip8::loadState(const Snapshot &snapshot) {
+    if (snapshot.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Error: snapshot version");
+    }
+    // Checked before anything is restored, a rejected snapshot leaves the machine as it was
+    if (snapshot.quirks >= static_cast<uint8_t>(QuirkProfile::Count)) {
+        throw std::runtime_error("Error: snapshot quirk profile");
+    }
+    // The next 00EE/2NNN indexes the stack with sp and the next fetch reads two bytes at pc
+    if (snapshot.sp < -1 || snapshot.sp > 15 || snapshot.pc > 4094) {
+        throw std::runtime_error("Error: snapshot registers out of range");
+    }
+
+    opcode = snapshot.opcode;
+    I = snapshot.I;
+    pc = snapshot.pc;
+    memcpy(stack, snapshot.stack, sizeof(stack));
+    sp = snapshot.sp;
+    delayTimer = snapshot.delayTimer;
+    soundTimer = snapshot.soundTimer;
+    waitForKey = snapshot.flags & SNAPSHOT_WAIT_FOR_KEY;
+    isRunning = snapshot.flags & SNAPSHOT_RUNNING;
+    drawFlag = snapshot.flags & SNAPSHOT_DRAW;
+    highRes = snapshot.flags & SNAPSHOT_HIGH_RES;
+    exited = snapshot.flags & SNAPSHOT_EXITED;
+    quirks = static_cast<QuirkProfile>(snapshot.quirks);
+    table = decodeTable(highRes, quirks);
+    if (jit) {
+        jit->setQuirks(quirks);
+    }
+    memcpy(V, snapshot.V, sizeof(V));
+    memcpy(keys, snapshot.keys, sizeof(keys));
+    seed = snapshot.seed;
+    rngState = snapshot.rngState;
+    memcpy(userFlags, snapshot.userFlags, sizeof(userFlags));
+    memcpy(display, snapshot.display, sizeof(display));
+    memcpy(memory, snapshot.memory, sizeof(memory));
+
+    fault = Fault::None;
+    // Presses of another timeline are not followed
+    std::fill_n(keyTags, 16, 0);
+    seenTag = 0;
+    drawnTag = 0;
+
+    // Code may differ everywhere and the whole screen has to be redrawn
+    invalidateCode(0, 4096);
+    dirtyRows = ~0ULL;
+    // A beep starts or stops if the restored state differs
+    updateSound();
+}
+
+void Chip8::invalidateCode(const uint16_t address, const uint16_t length) {
+    if (jit) {
+        jit->invalidate(address, length);
+    }
+    if (!icache) {
+        return;
+    }
+
+    // The instruction starting one byte before the write overlaps it too
+    uint16_t first = address > 0 ? address - 1 : 0;
+    uint16_t last = std::min(address + length, 4096);
+    for (uint16_t i = first; i < last; i++) {
+        if (icache[i]) {
+            icache[i] = nullptr;
+            cacheStats.invalidations++;
+        }
+    }
 }
 
 bool Chip8::decodeOpCode(const uint16_t opcode) {
     switch (opcode & 0xF000) {
         case 0x0: {
+            if ((opcode & 0xFFF0) == 0x00C0) {
+                // SUPER-CHIP: scrolls the display down by N rows
+                if (highRes) {
+                    scrollDown<HighRes>(display, dirtyRows, opcode & 0x0F);
+                }
+                else {
+                    scrollDown<LowRes>(display, dirtyRows, opcode & 0x0F);
+                }
+                pc += 2;
+                drawFlag = true;
+                frameDrawn = true;
+                break;
+            }
+            // The SUPER-CHIP opcodes are whole words, 0NFB-0NFF with N above 0 are machine code calls
+            if ((opcode & 0x0F00) && (opcode & 0x0FF) >= 0x0FB) {
+                return false;
+            }
             switch (opcode & 0x0FF) {
                 case 0x0E0: { // Clear screan
-                    std::fill_n(pixels, RES, 0);
+                    if (highRes) {
+                        clearDisplay<HighRes>(display, dirtyRows);
+                    }
+                    else {
+                        clearDisplay<LowRes>(display, dirtyRows);
+                    }
+                    drawn();
                     pc += 2;
                     drawFlag = true;
+                    frameDrawn = true;
                     break;
                 }
                 case 0x0EE: { // Return from subroutine
+                    if (sp < 0) {
+                        fault = Fault::StackUnderflow;
+                        return false;
+                    }
                     pc = stack[sp--];
                     pc += 2; // When returning, point to the next instuction
                     break;
                 }
+                case 0x0FB: {
+                    // SUPER-CHIP: scrolls the display right by 4 pixels
+                    if (highRes) {
+                        scrollRight<HighRes>(display, dirtyRows);
+                    }
+                    else {
+                        scrollRight<LowRes>(display, dirtyRows);
+                    }
+                    pc += 2;
+                    drawFlag = true;
+                    frameDrawn = true;
+                    break;
+                }
+                case 0x0FC: {
+                    // SUPER-CHIP: scrolls the display left by 4 pixels
+                    if (highRes) {
+                        scrollLeft<HighRes>(display, dirtyRows);
+                    }
+                    else {
+                        scrollLeft<LowRes>(display, dirtyRows);
+                    }
+                    pc += 2;
+                    drawFlag = true;
+                    frameDrawn = true;
+                    break;
+                }
+                case 0x0FD: {
+                    // SUPER-CHIP: exits the interpreter, the machine stays halted
+                    exited = true;
+                    isRunning = false;
+                    break;
+                }
+                case 0x0FE: {
+                    // SUPER-CHIP: 64x32 mode
+                    setDisplayMode(false);
+                    pc += 2;
+                    break;
+                }
+                case 0x0FF: {
+                    // SUPER-CHIP: 128x64 mode
+                    setDisplayMode(true);
+                    pc += 2;
+                    break;
+                }
                 default: {
                     return false;
                 }
@@ -157,6 +739,10 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
             break;
         }
         case 0x2000: { // Call subroutine
+            if (sp >= 15) {
+                fault = Fault::StackOverflow;
+                return false;
+            }
             stack[++sp] = pc;
             pc = opcode & 0x0FFF;
             break;
@@ -172,7 +758,7 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
         case 0x4000: {
             // Skips the next instruction if VX doesn't equal NN
             if (V[opcode >> 8 & 0x0F] != (opcode & 0x0FF)) {
-                pc += 4; // TODO FIX
+                pc += 2;
             }
             pc += 2;
             break;
@@ -208,18 +794,27 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                 case 0x01: {
                     // Sets VX to VX or VY
                     V[opcode >> 8 & 0xF] |= V[opcode >> 4 & 0xF];
+                    if (quirksOf(quirks).logicResetsVF) {
+                        V[0xF] = 0;
+                    }
                     pc += 2;
                     break;
                 }
                 case 0x02: {
                     // Sets VX to VX and VY
                     V[opcode >> 8 & 0xF] &= V[opcode >> 4 & 0xF];
+                    if (quirksOf(quirks).logicResetsVF) {
+                        V[0xF] = 0;
+                    }
                     pc += 2;
                     break;
                 }
                 case 0x03: {
                     // Sets VX to VX xor VY
                     V[opcode >> 8 & 0xF] ^= V[opcode >> 4 & 0xF];
+                    if (quirksOf(quirks).logicResetsVF) {
+                        V[0xF] = 0;
+                    }
                     pc += 2;
                     break;
                 }
@@ -243,8 +838,17 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                 }
                 case 0x06: {
                     // Stores the least significant bit of VX in VF and then shifts VX to the right by 1.
-                    V[0xF] = V[opcode >> 8 & 0x0F] & 0x01;
-                    V[opcode >> 8 & 0x0F] >>= 1;
+                    // The COSMAC VIP shifts VY into VX instead. Otherwise VX is shifted after the flag
+                    // is written, so 8FX6 shifts the flag itself.
+                    if (quirksOf(quirks).shiftUsesVY) {
+                        const uint8_t value = V[opcode >> 4 & 0x0F];
+                        V[0xF] = value & 0x01;
+                        V[opcode >> 8 & 0x0F] = value >> 1;
+                    }
+                    else {
+                        V[0xF] = V[opcode >> 8 & 0x0F] & 0x01;
+                        V[opcode >> 8 & 0x0F] >>= 1;
+                    }
                     pc += 2;
                     break;
                 }
@@ -261,8 +865,15 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                 case 0x0E: {
                     // 	Stores the most significant bit of VX in VF
                     // and then shifts VX to the left by 1
-                    V[0x0F] = V[opcode >> 8 & 0x0F] >> 7;
-                    V[opcode >> 8 & 0x0F] <<= 1;
+                    if (quirksOf(quirks).shiftUsesVY) {
+                        const uint8_t value = V[opcode >> 4 & 0x0F];
+                        V[0x0F] = value >> 7;
+                        V[opcode >> 8 & 0x0F] = value << 1;
+                    }
+                    else {
+                        V[0x0F] = V[opcode >> 8 & 0x0F] >> 7;
+                        V[opcode >> 8 & 0x0F] <<= 1;
+                    }
                     pc += 2;
                     break;
                 }
@@ -287,47 +898,68 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
             break;
         }
         case 0xB000: {
-            // Jumps to the address NNN plus V0
-            pc = (opcode & 0x0FFF) + V[0x0];
+            // Jumps to the address NNN plus V0, SUPER-CHIP adds VX
+            pc = (opcode & 0x0FFF) + V[quirksOf(quirks).jumpUsesVX ? opcode >> 8 & 0x0F : 0x0];
             break;
         }
         case 0xC000: {
             // Sets VX to the result of a bitwise and operation on a random number
             // (Typically: 0 to 255) and NN
-            V[opcode >> 8 & 0x0F] = (std::rand() % 0xFF) & (opcode & 0x0FF);
+            V[opcode >> 8 & 0x0F] = rngByte(rngState) & (opcode & 0x0FF);
             pc += 2;
+            break;
         }
         case 0xD000: {
             // DXYN: Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a
             // height of N pixels. Each row of 8 pixels is read as bit-coded starting from memory
             // location I; I value doesnt change after the execution of this instruction. As described
             // above, VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is
-            // drawn, and to 0 if that doesnt happen
-            uint8_t vx = V[opcode >> 8 & 0x0F];
-            uint8_t vy = V[opcode >> 4 & 0x0F];
-            uint16_t height = opcode & 0x0F;
-            uint16_t pixel;
-
-            V[0x0F] = 0;
-            for (uint16_t yline = 0; yline < height; yline++) {
-                pixel = memory[I + yline];
-                for (uint16_t xline = 0; xline < 8; xline++) {
-                    if ((pixel & (0x80 >> xline)) != 0) {
-                        if (pixels[(vx + xline + ((vy + yline) * 64))] == 1) {
-                            V[0x0F] = 1;
-                        }
-                        pixels[vx + xline + ((vy + yline) * 64)] ^= 1;
-                    }
+            // drawn, and to 0 if that doesnt happen. Sprites wrap around the screen edges
+            // SUPER-CHIP: DXY0 draws a 16x16 sprite of two bytes per row
+            // N rows of one byte, or 16 rows of two
+            if (I + ((opcode & 0x0F) ? (opcode & 0x0F) : 32) > 4096) {
+                fault = Fault::MemoryOutOfBounds;
+                return false;
+            }
+            const uint8_t x = V[opcode >> 8 & 0x0F];
+            const uint8_t y = V[opcode >> 4 & 0x0F];
+            bool collision;
+            if (quirksOf(quirks).clipSprites) {
+                // Cut at the edges instead
+                if (opcode & 0x0F) {
+                    collision = highRes ? blitSprite<HighRes, true>(display, dirtyRows, x, y, memory + I, opcode & 0x0F)
+                        : blitSprite<LowRes, true>(display, dirtyRows, x, y, memory + I, opcode & 0x0F);
                 }
+                else {
+                    collision = highRes ? blitSprite16<HighRes, true>(display, dirtyRows, x, y, memory + I)
+                        : blitSprite16<LowRes, true>(display, dirtyRows, x, y, memory + I);
+                }
+            }
+            else if (opcode & 0x0F) {
+                collision = highRes ? blitSprite<HighRes>(display, dirtyRows, x, y, memory + I, opcode & 0x0F)
+                    : blitSprite<LowRes>(display, dirtyRows, x, y, memory + I, opcode & 0x0F);
             }
+            else {
+                collision = highRes ? blitSprite16<HighRes>(display, dirtyRows, x, y, memory + I)
+                    : blitSprite16<LowRes>(display, dirtyRows, x, y, memory + I);
+            }
+            V[0x0F] = collision ? 1 : 0;
+            drawn();
+            drawCalls++;
             pc += 2;
             drawFlag = true;
+            frameDrawn = true;
             break;
         }
         case 0xE000: {
             switch (opcode & 0x0FF) {
                 case 0x09E: { //TODO Check
                     // Skips the next instruction if the keys stored in VX is pressed
+                    if (V[opcode >> 8 & 0x0F] > 0x0F) {
+                        fault = Fault::KeyOutOfRange;
+                        return false;
+                    }
+                    readKey(V[opcode >> 8 & 0x0F]);
                     if (keys[V[opcode >> 8 & 0x0F]]) {
                         pc += 2;
                     }
@@ -336,6 +968,11 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                 }
                 case 0xA1: { // TODO check
                     // Skips the next instruction if the keys stored in VX isn't pressed
+                    if (V[opcode >> 8 & 0x0F] > 0x0F) {
+                        fault = Fault::KeyOutOfRange;
+                        return false;
+                    }
+                    readKey(V[opcode >> 8 & 0x0F]);
                     if (!keys[V[opcode >> 8 & 0x0F]]) {
                         pc += 2;
                     }
@@ -372,6 +1009,7 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                 case 0x018: {
                     // Sets the sound timer to VX
                     soundTimer = V[opcode >> 8 & 0x0F];
+                    updateSound();
                     pc += 2;
                     break;
                 }
@@ -380,11 +1018,9 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                     // VF is set to 1 when there is a range overflow
                     // and to 0 when there isn't
                     //V[0xF] = (I + (opcode >> 8 & 0x0F) > 0xFFF ? 1 : 0);
-					if (I > (0xfff - V[(opcode & 0x0f00) >> 8])){
-                        V[0xf] = 1;
-                    }
-                    else {
-                        V[0xf] = 0;
+                    // Only with the Legacy quirks, see quirks.hpp
+                    if (quirksOf(quirks).addISetsVF) {
+                        V[0xf] = I > (0xfff - V[(opcode & 0x0f00) >> 8]) ? 1 : 0;
                     }
                     I += V[opcode >> 8 & 0x0F];
                     pc += 2;
@@ -397,36 +1033,82 @@ bool Chip8::decodeOpCode(const uint16_t opcode) {
                     pc += 2;
                     break;
                 }
+                case 0x030: {
+                    // SUPER-CHIP: sets I to the 8x10 sprite of the digit in VX
+                    I = BIG_FONT_ADDRESS + (V[opcode >> 8 & 0x0F] & 0x0F) * 10;
+                    pc += 2;
+                    break;
+                }
                 case 0x033: {
                     // Stores the binary-coded decimal representation of VX, with the most significant
                     // of three digits at the address in I, the middle digit at I plus 1, and the least
                     // significant digit at I plus 2. (In other words, take the decimal representation of
                     // VX, place the hundreds digit in memory at location in I, the tens digit at location
                     // I+1, and the ones digit at location I+2.)
+                    if (I + 3 > 4096) {
+                        fault = Fault::MemoryOutOfBounds;
+                        return false;
+                    }
                     memory[I] = V[(opcode & 0x0F00) >> 8] / 100;
                     memory[I + 1] = (V[(opcode & 0x0F00) >> 8] / 10) % 10;
                     memory[I + 2] = (V[(opcode & 0x0F00) >> 8] % 100) % 10;
+                    invalidateCode(I, 3);
                     pc += 2;
                     break;
                 }
                 case 0x055: {
                     // Stores V0 to VX (including VX) in memory starting at address I.
                     // The offset from I is increased by 1 for each value written, but I itself is left unmodified
+                    if (I + (opcode >> 8 & 0x0F) + 1 > 4096) {
+                        fault = Fault::MemoryOutOfBounds;
+                        return false;
+                    }
                     for (uint16_t i = 0; i <= (opcode >> 8 & 0x0F); i++) {
                         memory[I + i] = V[i];
                     }
+                    invalidateCode(I, (opcode >> 8 & 0x0F) + 1);
+                    // The COSMAC VIP and XO-CHIP do move I
+                    if (quirksOf(quirks).loadStoreIncrementsI) {
+                        I += (opcode >> 8 & 0x0F) + 1;
+                    }
                     pc += 2;
                     break;
                 }
                 case 0x65: {
+                    if (I + (opcode >> 8 & 0x0F) + 1 > 4096) {
+                        fault = Fault::MemoryOutOfBounds;
+                        return false;
+                    }
                     for (uint16_t i = 0; i <= (opcode >> 8 & 0x0F); i++) {
                         // Fills V0 to VX (including VX) with values from memory starting at address I.
                         // The offset from I is increased by 1 for each value written, but I itself is left unmodified.
                         V[i] = memory[I + i];
                     }
+                    if (quirksOf(quirks).loadStoreIncrementsI) {
+                        I += (opcode >> 8 & 0x0F) + 1;
+                    }
+                    pc += 2;
+                    break;
+                }
+                case 0x75: {
+                    // SUPER-CHIP: stores V0 to VX in the user flags
+                    for (uint16_t i = 0; i <= (opcode >> 8 & 0x0F); i++) {
+                        userFlags[i] = V[i];
+                    }
+                    pc += 2;
+                    break;
+                }
+                case 0x85: {
+                    // SUPER-CHIP: fills V0 to VX from the user flags
+                    for (uint16_t i = 0; i <= (opcode >> 8 & 0x0F); i++) {
+                        V[i] = userFlags[i];
+                    }
                     pc += 2;
                     break;
                 }
+                default: {
+                    return false;
+                }
             }
             break;
         }
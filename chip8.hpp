@@ -1,7 +1,107 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include "opcodes.hpp"
+#include "display.hpp"
+#include "quirks.hpp"
+#include "rng.hpp"
+#include "SpscQueue.hpp"
 
-#define RES 64 * 32
+class Jit;
+class GdbStub;
+class Profiler;
+class TraceWriter;
+class Rom;
+
+// Pixels of the largest display mode
+#define RES DISPLAY_HIRES_WIDTH * DISPLAY_HIRES_HEIGHT
+
+// SUPER-CHIP 8x10 digits, FX30, after the 4x5 font at 0
+#define BIG_FONT_ADDRESS 0x50
+
+// Interpreter core used by emulateCycle
+enum class Dispatch {
+	Switch, // Nested switch in decodeOpCode
+	Table,  // 64K pre-decoded instruction table
+	Cached, // Table entries cached per memory address
+	Jit     // x86-64 basic-block translation, see Jit.hpp
+};
+
+// Why an instruction could not run. The instruction is not retired, pc
+// still points at it.
+enum class Fault : uint8_t {
+	None,
+	InvalidOpcode,
+	StackOverflow,     // 2NNN with all 16 levels in use
+	StackUnderflow,    // 00EE with an empty stack
+	MemoryOutOfBounds, // I based access or the fetch past the end of memory
+	KeyOutOfRange      // EX9E/EXA1 with VX above F
+};
+
+const char* faultName(const Fault fault);
+
+// Counters of the decoded-instruction cache
+struct CacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t invalidations; // Cached entries dropped by memory writes
+};
+
+// The sound timer became non-zero (on) or reached zero (off).
+// The time is guest time: `tick` 60 Hz timer ticks plus `cycle` instructions
+// executed since the last of them.
+struct SoundEdge {
+	uint64_t tick;
+	uint32_t cycle;
+	bool on;
+};
+
+// Edges from the emulation thread to the audio thread
+typedef SpscQueue<SoundEdge, 256> SoundQueue;
+
+// Running totals since the machine was created, see getMetrics. Every
+// counter is one add per instruction, DXYN or tick, so they are always on.
+struct Metrics {
+	uint64_t instructions; // Retired, as getCycles
+	uint64_t frames;       // tickTimers calls
+	uint64_t drawFrames;   // Ticks in which the display changed
+	uint64_t drawCalls;    // DXYN executed
+	uint64_t keyWaitTicks; // Ticks spent waiting in FX0A
+};
+
+#define SNAPSHOT_VERSION 3
+
+// Complete machine state, laid out without padding so snapshots can be
+// compared and delta-encoded byte by byte
+struct Snapshot {
+	uint32_t version;
+	uint16_t opcode;
+	uint16_t I;
+	uint16_t pc;
+	uint16_t stack[16];
+	int8_t sp;
+	uint8_t delayTimer;
+	uint8_t soundTimer;
+	uint8_t flags; // SNAPSHOT_* bits below
+	uint8_t V[16];
+	uint8_t keys[16];
+	uint8_t quirks; // QuirkProfile
+	uint8_t reserved;
+	uint64_t seed;
+	uint64_t rngState;
+	uint8_t userFlags[16]; // FX75/FX85
+	uint64_t display[DISPLAY_WORDS];
+	uint8_t memory[4096];
+};
+static_assert(sizeof(Snapshot) == 5232, "Snapshot must not contain padding");
+
+#define SNAPSHOT_WAIT_FOR_KEY 0x01
+#define SNAPSHOT_RUNNING 0x02
+#define SNAPSHOT_DRAW 0x04
+#define SNAPSHOT_HIGH_RES 0x08
+#define SNAPSHOT_EXITED 0x10
 
 class Chip8 {
 private:
@@ -13,14 +113,92 @@ private:
 	bool waitForKey;
 	bool isRunning;
 	bool drawFlag;
-	void *sound;
-	void (*playSound)(void *sound);
+	Dispatch dispatch;
 
-	uint8_t pixels[RES];
+	uint64_t display[DISPLAY_WORDS]; // One bit per pixel, see display.hpp
+	uint64_t dirtyRows; // Rows changed since the last takeDirtyRows
+	bool highRes; // SUPER-CHIP 128x64 mode
+	bool exited; // Stopped by 00FD
 	uint8_t keys[16];
+	uint8_t userFlags[16]; // SUPER-CHIP RPL flags of FX75/FX85
+
+	// Input latency tags, see keyPress. Not part of the machine state.
+	uint32_t keyTags[16]; // Of the last press per key, until the guest reads the key
+	uint32_t seenTag;     // Read by EX9E/EXA1 or FX0A, not drawn yet
+	uint32_t drawnTag;    // Drawn, not taken yet
+	inline void readKey(const uint8_t key) {
+		if (keyTags[key & 0x0F]) {
+			seenTag = keyTags[key & 0x0F];
+			keyTags[key & 0x0F] = 0;
+		}
+	}
+	inline void drawn(void) {
+		if (seenTag) {
+			drawnTag = seenTag;
+			seenTag = 0;
+		}
+	}
+
+	// CXNN generator, see rng.hpp
+	uint64_t seed;
+	uint64_t rngState;
+
+	QuirkProfile quirks;
+
+	// Instruction handlers of the table dispatcher, one set per display mode
+	// and quirk profile
+	template <typename G, QuirkProfile P> struct Ops;
+	static const Instruction* decodeTable(const bool highRes, const QuirkProfile quirks);
+	const Instruction *table; // Of the current display mode and quirks
+	void setDisplayMode(const bool highRes);
+
+	// Decoded instruction per address, allocated when Dispatch::Cached is selected
+	std::unique_ptr<const Instruction*[]> icache;
+	CacheStats cacheStats;
+	void invalidateCode(const uint16_t address, const uint16_t length);
+
+	// Fast-forwards a guest polling the delay timer, see run
+	uint64_t skipIdleLoop(const uint64_t budget);
+
+	// Allocated when Dispatch::Jit is selected
+	std::unique_ptr<Jit> jit;
+
+	// Sound edges are published here, nothing is published without a queue
+	SoundQueue *soundQueue;
+	bool soundOn;
+	uint64_t timerTicks; // tickTimers calls
+	uint64_t tickCycle;  // cycleCount at the last of them
+	void updateSound(void);
+
+	// Set when an instruction faults, see runUntilFault
+	Fault fault;
+	bool step(void);
+	// The loop of runUntilFault. Only the Debugging instantiation checks
+	// breakpoints, it is used while a debugger is attached.
+	template <bool Debugging> uint64_t runLoop(const uint64_t cycles);
+
+	// Not owned, null unless a debugger is attached. It reads and writes the
+	// whole machine state.
+	GdbStub *debugger;
+	friend class GdbStub;
+
+	uint64_t cycleCount; // Instructions retired
+	// Metrics counters, not part of the machine state
+	uint64_t drawCalls;
+	bool frameDrawn; // Since the last tick
+	uint64_t drawFrames;
+	uint64_t keyWaitTicks;
+	// Open while an execution trace is recorded, see Trace.hpp
+	std::unique_ptr<TraceWriter> trace;
+
+#ifdef CHIP8_PROFILING
+	// Allocated while profiling is enabled
+	std::unique_ptr<Profiler> profiler;
+#endif
 
 public:
 	Chip8();
+	~Chip8();
 
 	uint16_t stack[16];
 	int8_t sp;
@@ -28,13 +206,60 @@ public:
 	uint8_t soundTimer;
 
 	bool decodeOpCode(const uint16_t opcode);
-	void keyPress(const uint8_t key);
+	// A non-zero tag follows the press through the instruction that reads the
+	// key to the next 00E0 or DXYN, see takeInputTag
+	void keyPress(const uint8_t key, const uint32_t tag = 0);
 	void keyRelease(const uint8_t key);
 	void loadROM(const char* fName);
-	uint8_t (&getPixels(void))[RES];
+	void loadROM(const Rom &rom);
+	// Raw bytes at the program start, cut to the memory that is left
+	void loadProgram(const uint8_t *data, const size_t size);
+	const uint64_t (&getDisplay(void))[DISPLAY_WORDS];
+	bool isHighRes(void);
+	unsigned getDisplayWidth(void);
+	unsigned getDisplayHeight(void);
+	uint64_t getDisplayHash(void);
+	void getPixels(uint8_t (&pixels)[RES]);
+	uint64_t takeDirtyRows(void);
+	// Tag of the newest press the display responded to since the last call, 0 if none
+	uint32_t takeInputTag(void);
 	bool getDrawFlag(void);
+	bool isWaitingForKey(void);
+	bool hasExited(void);
 	void setDrawFlag(bool flag);
+	// Throws OpCodeException on a fault
 	void emulateCycle(void);
-	void setSound(void (*func)(void *sound), void *sound);
+	// Runs up to `cycles` instructions, fewer if the guest stops or waits
+	// for a key. Idle loops on the delay timer are retired without running
+	// them, with exactly the same result. Throws OpCodeException on a fault.
+	uint64_t run(const uint64_t cycles);
+	// Like run, but stops at a fault instead of throwing, see getFault
+	uint64_t runUntilFault(const uint64_t cycles);
+	// Of the last emulateCycle or run call
+	Fault getFault(void);
+	void tickTimers(void);
+	void setSoundQueue(SoundQueue *queue);
+	// Breakpoints, watchpoints and faults stop runUntilFault while attached,
+	// faults are then reported to the debugger instead of the caller
+	void setDebugger(GdbStub *debugger);
+	void setDispatch(Dispatch dispatch);
+	Dispatch getDispatch(void);
+	CacheStats getCacheStats(void);
+	bool isJitAvailable(void);
+	void saveState(Snapshot &snapshot);
+	void loadState(const Snapshot &snapshot);
+	void setSeed(const uint64_t seed);
+	uint64_t getSeed(void);
+	void setQuirks(const QuirkProfile quirks);
+	QuirkProfile getQuirks(void);
+	void startTrace(const std::string &path);
+	void stopTrace(void);
+	uint64_t getCycles(void);
+	// Emulation thread only, copy the result to hand it to another thread
+	Metrics getMetrics(void);
+#ifdef CHIP8_PROFILING
+	void setProfiling(bool enabled);
+	Profiler* getProfiler(void);
+#endif
 
 };
\ No newline at end of file
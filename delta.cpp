@@ -0,0 +1,93 @@
+#include "delta.hpp"
+#include <cstring>
+
+static void putVarint(std::vector<uint8_t> &out, size_t value) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t *&in, const uint8_t *end, size_t &value) {
+	value = 0;
+	for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+		uint8_t byte = *in++;
+		value |= static_cast<size_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Length of the run of equal bytes starting at offset
+static size_t equalRun(const uint8_t *a, const uint8_t *b, size_t offset, const size_t size) {
+	size_t start = offset;
+
+	// Compare a word at a time, snapshots are mostly unchanged
+	while (offset + 8 <= size) {
+		uint64_t x, y;
+		memcpy(&x, a + offset, 8);
+		memcpy(&y, b + offset, 8);
+		if (x != y) {
+			break;
+		}
+		offset += 8;
+	}
+	while (offset < size && a[offset] == b[offset]) {
+		offset++;
+	}
+	return offset - start;
+}
+
+void encodeDelta(const uint8_t *previous, const uint8_t *current, const size_t size, std::vector<uint8_t> &out) {
+	out.clear();
+	size_t offset = 0;
+
+	while (offset < size) {
+		size_t zeros = equalRun(previous, current, offset, size);
+		offset += zeros;
+		if (offset == size) {
+			// Trailing equal bytes are implied
+			break;
+		}
+
+		// Literal run lasts until at least 4 equal bytes follow
+		size_t literalStart = offset;
+		while (offset < size) {
+			if (previous[offset] == current[offset]
+				&& offset + 4 <= size && equalRun(previous, current, offset, offset + 4) == 4) {
+				break;
+			}
+			offset++;
+		}
+
+		putVarint(out, zeros);
+		putVarint(out, offset - literalStart);
+		for (size_t i = literalStart; i < offset; i++) {
+			out.push_back(previous[i] ^ current[i]);
+		}
+	}
+}
+
+bool applyDelta(uint8_t *data, const size_t size, const uint8_t *delta, const size_t length) {
+	const uint8_t *in = delta;
+	const uint8_t *end = delta + length;
+	size_t offset = 0;
+
+	while (in < end) {
+		size_t zeros, literals;
+		if (!getVarint(in, end, zeros) || !getVarint(in, end, literals)) {
+			return false;
+		}
+		offset += zeros;
+		if (offset > size || literals > size - offset || literals > static_cast<size_t>(end - in)) {
+			return false;
+		}
+		for (size_t i = 0; i < literals; i++) {
+			data[offset++] ^= *in++;
+		}
+	}
+	return true;
+}
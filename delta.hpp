@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// XOR delta with run-length encoded zero runs.
+// The stream is a sequence of (zero run, literal length, literal bytes),
+// lengths are LEB128 varints and literals hold previous ^ current.
+// Applying a delta to either side yields the other one.
+
+void encodeDelta(const uint8_t *previous, const uint8_t *current, const size_t size, std::vector<uint8_t> &out);
+bool applyDelta(uint8_t *data, const size_t size, const uint8_t *delta, const size_t length);
@@ -0,0 +1,437 @@
+#include "chip8.hpp"
+#include <algorithm>
+
+// Handlers of the table dispatcher.
+// Every handler mirrors its case in Chip8::decodeOpCode, but receives
+// the operand fields already extracted from the opcode. Each display
+// geometry and quirk profile gets its own set, and its own table, so the
+// handlers know the mode and the quirks at compile time.
+template <typename G, QuirkProfile P>
+struct Chip8::Ops {
+	static constexpr Quirks quirks = quirksOf(P);
+
+	static bool invalid(Chip8 &, const Instruction &) {
+		return false;
+	}
+
+	// The instruction is not retired
+	static bool fail(Chip8 &c, const Fault fault) {
+		c.fault = fault;
+		return false;
+	}
+
+	static bool scrollDown(Chip8 &c, const Instruction &in) {
+		::scrollDown<G>(c.display, c.dirtyRows, in.n);
+		c.pc += 2;
+		c.drawFlag = true;
+		c.frameDrawn = true;
+		return true;
+	}
+
+	static bool cls(Chip8 &c, const Instruction &) {
+		clearDisplay<G>(c.display, c.dirtyRows);
+		c.drawn();
+		c.pc += 2;
+		c.drawFlag = true;
+		c.frameDrawn = true;
+		return true;
+	}
+
+	static bool ret(Chip8 &c, const Instruction &) {
+		if (c.sp < 0) {
+			return fail(c, Fault::StackUnderflow);
+		}
+		c.pc = c.stack[c.sp--];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool scrollRight(Chip8 &c, const Instruction &) {
+		::scrollRight<G>(c.display, c.dirtyRows);
+		c.pc += 2;
+		c.drawFlag = true;
+		c.frameDrawn = true;
+		return true;
+	}
+
+	static bool scrollLeft(Chip8 &c, const Instruction &) {
+		::scrollLeft<G>(c.display, c.dirtyRows);
+		c.pc += 2;
+		c.drawFlag = true;
+		c.frameDrawn = true;
+		return true;
+	}
+
+	static bool exit(Chip8 &c, const Instruction &) {
+		c.exited = true;
+		c.isRunning = false;
+		return true;
+	}
+
+	static bool lowRes(Chip8 &c, const Instruction &) {
+		c.setDisplayMode(false);
+		c.pc += 2;
+		return true;
+	}
+
+	static bool highRes(Chip8 &c, const Instruction &) {
+		c.setDisplayMode(true);
+		c.pc += 2;
+		return true;
+	}
+
+	static bool jump(Chip8 &c, const Instruction &in) {
+		c.pc = in.nnn;
+		return true;
+	}
+
+	static bool call(Chip8 &c, const Instruction &in) {
+		if (c.sp >= 15) {
+			return fail(c, Fault::StackOverflow);
+		}
+		c.stack[++c.sp] = c.pc;
+		c.pc = in.nnn;
+		return true;
+	}
+
+	static bool skipEqImm(Chip8 &c, const Instruction &in) {
+		c.pc += c.V[in.x] == in.nn ? 4 : 2;
+		return true;
+	}
+
+	static bool skipNeImm(Chip8 &c, const Instruction &in) {
+		c.pc += c.V[in.x] != in.nn ? 4 : 2;
+		return true;
+	}
+
+	static bool skipEqReg(Chip8 &c, const Instruction &in) {
+		c.pc += c.V[in.x] == c.V[in.y] ? 4 : 2;
+		return true;
+	}
+
+	static bool loadImm(Chip8 &c, const Instruction &in) {
+		c.V[in.x] = in.nn;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool addImm(Chip8 &c, const Instruction &in) {
+		c.V[in.x] += in.nn;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool move(Chip8 &c, const Instruction &in) {
+		c.V[in.x] = c.V[in.y];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool bitOr(Chip8 &c, const Instruction &in) {
+		c.V[in.x] |= c.V[in.y];
+		if constexpr (quirks.logicResetsVF) {
+			c.V[0xF] = 0;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool bitAnd(Chip8 &c, const Instruction &in) {
+		c.V[in.x] &= c.V[in.y];
+		if constexpr (quirks.logicResetsVF) {
+			c.V[0xF] = 0;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool bitXor(Chip8 &c, const Instruction &in) {
+		c.V[in.x] ^= c.V[in.y];
+		if constexpr (quirks.logicResetsVF) {
+			c.V[0xF] = 0;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool addReg(Chip8 &c, const Instruction &in) {
+		c.V[0xF] = c.V[in.y] > 0xFF - c.V[in.x] ? 1 : 0;
+		c.V[in.x] += c.V[in.y];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool subReg(Chip8 &c, const Instruction &in) {
+		c.V[0xF] = c.V[in.x] > c.V[in.y] ? 1 : 0;
+		c.V[in.x] -= c.V[in.y];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool shiftRight(Chip8 &c, const Instruction &in) {
+		if (quirks.shiftUsesVY) {
+			const uint8_t value = c.V[in.y];
+			c.V[0xF] = value & 0x01;
+			c.V[in.x] = value >> 1;
+		}
+		else {
+			// VX is read again after the flag is written, 8FX6 shifts the flag
+			c.V[0xF] = c.V[in.x] & 0x01;
+			c.V[in.x] >>= 1;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool subNeg(Chip8 &c, const Instruction &in) {
+		c.V[0xF] = c.V[in.y] > c.V[in.x] ? 1 : 0;
+		c.V[in.x] = c.V[in.y] - c.V[in.x];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool shiftLeft(Chip8 &c, const Instruction &in) {
+		if (quirks.shiftUsesVY) {
+			const uint8_t value = c.V[in.y];
+			c.V[0xF] = value >> 7;
+			c.V[in.x] = value << 1;
+		}
+		else {
+			c.V[0xF] = c.V[in.x] >> 7;
+			c.V[in.x] <<= 1;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool skipNeReg(Chip8 &c, const Instruction &in) {
+		c.pc += c.V[in.x] != c.V[in.y] ? 4 : 2;
+		return true;
+	}
+
+	static bool loadI(Chip8 &c, const Instruction &in) {
+		c.I = in.nnn;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool jumpV0(Chip8 &c, const Instruction &in) {
+		c.pc = in.nnn + c.V[quirks.jumpUsesVX ? in.x : 0x0];
+		return true;
+	}
+
+	static bool random(Chip8 &c, const Instruction &in) {
+		c.V[in.x] = rngByte(c.rngState) & in.nn;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool draw(Chip8 &c, const Instruction &in) {
+		if (c.I + in.n > 4096) {
+			return fail(c, Fault::MemoryOutOfBounds);
+		}
+		c.V[0x0F] = blitSprite<G, quirks.clipSprites>(c.display, c.dirtyRows, c.V[in.x], c.V[in.y], c.memory + c.I, in.n) ? 1 : 0;
+		c.drawn();
+		c.drawCalls++;
+		c.pc += 2;
+		c.drawFlag = true;
+		c.frameDrawn = true;
+		return true;
+	}
+
+	static bool draw16(Chip8 &c, const Instruction &in) {
+		if (c.I + 32 > 4096) {
+			return fail(c, Fault::MemoryOutOfBounds);
+		}
+		c.V[0x0F] = blitSprite16<G, quirks.clipSprites>(c.display, c.dirtyRows, c.V[in.x], c.V[in.y], c.memory + c.I) ? 1 : 0;
+		c.drawn();
+		c.drawCalls++;
+		c.pc += 2;
+		c.drawFlag = true;
+		c.frameDrawn = true;
+		return true;
+	}
+
+	static bool skipKey(Chip8 &c, const Instruction &in) {
+		if (c.V[in.x] > 0x0F) {
+			return fail(c, Fault::KeyOutOfRange);
+		}
+		c.readKey(c.V[in.x]);
+		c.pc += c.keys[c.V[in.x]] ? 4 : 2;
+		return true;
+	}
+
+	static bool skipNoKey(Chip8 &c, const Instruction &in) {
+		if (c.V[in.x] > 0x0F) {
+			return fail(c, Fault::KeyOutOfRange);
+		}
+		c.readKey(c.V[in.x]);
+		c.pc += !c.keys[c.V[in.x]] ? 4 : 2;
+		return true;
+	}
+
+	static bool getDelay(Chip8 &c, const Instruction &in) {
+		c.V[in.x] = c.delayTimer;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool waitKey(Chip8 &c, const Instruction &) {
+		c.waitForKey = true;
+		c.isRunning = false;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool setDelay(Chip8 &c, const Instruction &in) {
+		c.delayTimer = c.V[in.x];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool setSound(Chip8 &c, const Instruction &in) {
+		c.soundTimer = c.V[in.x];
+		c.updateSound();
+		c.pc += 2;
+		return true;
+	}
+
+	static bool addI(Chip8 &c, const Instruction &in) {
+		if constexpr (quirks.addISetsVF) {
+			c.V[0xF] = c.I > 0xFFF - c.V[in.x] ? 1 : 0;
+		}
+		c.I += c.V[in.x];
+		c.pc += 2;
+		return true;
+	}
+
+	static bool font(Chip8 &c, const Instruction &in) {
+		c.I = c.V[in.x] * 5;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool bigFont(Chip8 &c, const Instruction &in) {
+		c.I = BIG_FONT_ADDRESS + (c.V[in.x] & 0x0F) * 10;
+		c.pc += 2;
+		return true;
+	}
+
+	static bool bcd(Chip8 &c, const Instruction &in) {
+		if (c.I + 3 > 4096) {
+			return fail(c, Fault::MemoryOutOfBounds);
+		}
+		c.memory[c.I] = c.V[in.x] / 100;
+		c.memory[c.I + 1] = (c.V[in.x] / 10) % 10;
+		c.memory[c.I + 2] = c.V[in.x] % 10;
+		c.invalidateCode(c.I, 3);
+		c.pc += 2;
+		return true;
+	}
+
+	static bool store(Chip8 &c, const Instruction &in) {
+		if (c.I + in.x + 1 > 4096) {
+			return fail(c, Fault::MemoryOutOfBounds);
+		}
+		for (uint16_t i = 0; i <= in.x; i++) {
+			c.memory[c.I + i] = c.V[i];
+		}
+		c.invalidateCode(c.I, in.x + 1);
+		if constexpr (quirks.loadStoreIncrementsI) {
+			c.I += in.x + 1;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool load(Chip8 &c, const Instruction &in) {
+		if (c.I + in.x + 1 > 4096) {
+			return fail(c, Fault::MemoryOutOfBounds);
+		}
+		for (uint16_t i = 0; i <= in.x; i++) {
+			c.V[i] = c.memory[c.I + i];
+		}
+		if constexpr (quirks.loadStoreIncrementsI) {
+			c.I += in.x + 1;
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool saveFlags(Chip8 &c, const Instruction &in) {
+		for (uint16_t i = 0; i <= in.x; i++) {
+			c.userFlags[i] = c.V[i];
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static bool loadFlags(Chip8 &c, const Instruction &in) {
+		for (uint16_t i = 0; i <= in.x; i++) {
+			c.V[i] = c.userFlags[i];
+		}
+		c.pc += 2;
+		return true;
+	}
+
+	static Instruction* buildTable(void);
+
+	static const Instruction* table(void) {
+		// Built once, on first use, and shared by every instance
+		static const Instruction *instructions = buildTable();
+		return instructions;
+	}
+};
+
+template <typename G, QuirkProfile P>
+Instruction* Chip8::Ops<G, P>::buildTable(void) {
+	typedef bool (*Handler)(Chip8 &chip8, const Instruction &instr);
+
+	// Indexed by OpClass
+	static const Handler handlers[] = {
+		scrollDown, cls, ret,
+		scrollRight, scrollLeft, exit, lowRes, highRes,
+		jump, call,
+		skipEqImm, skipNeImm, skipEqReg,
+		loadImm, addImm,
+		move, bitOr, bitAnd, bitXor,
+		addReg, subReg, shiftRight,
+		subNeg, shiftLeft,
+		skipNeReg, loadI, jumpV0,
+		random, draw, draw16,
+		skipKey, skipNoKey,
+		getDelay, waitKey, setDelay,
+		setSound, addI, font, bigFont,
+		bcd, store, load,
+		saveFlags, loadFlags,
+		invalid
+	};
+	static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<int>(OpClass::Count),
+		"Every instruction class needs a handler");
+
+	static Instruction table[0x10000];
+	for (uint32_t opcode = 0; opcode < 0x10000; opcode++) {
+		Instruction &instr = table[opcode];
+		instr.execute = handlers[static_cast<int>(classifyOpCode(opcode))];
+		instr.nnn = opcode & 0x0FFF;
+		instr.x = opcode >> 8 & 0x0F;
+		instr.y = opcode >> 4 & 0x0F;
+		instr.nn = opcode & 0x0FF;
+		instr.n = opcode & 0x0F;
+	}
+	return table;
+}
+
+const Instruction* Chip8::decodeTable(const bool highRes, const QuirkProfile quirks) {
+	// The quirks are picked once per machine here, not per instruction
+	switch (quirks) {
+		case QuirkProfile::CosmacVip:
+			return highRes ? Ops<HighRes, QuirkProfile::CosmacVip>::table() : Ops<LowRes, QuirkProfile::CosmacVip>::table();
+		case QuirkProfile::Schip:
+			return highRes ? Ops<HighRes, QuirkProfile::Schip>::table() : Ops<LowRes, QuirkProfile::Schip>::table();
+		case QuirkProfile::XoChip:
+			return highRes ? Ops<HighRes, QuirkProfile::XoChip>::table() : Ops<LowRes, QuirkProfile::XoChip>::table();
+		default:
+			return highRes ? Ops<HighRes, QuirkProfile::Legacy>::table() : Ops<LowRes, QuirkProfile::Legacy>::table();
+	}
+}
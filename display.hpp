@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+
+#define DISPLAY_WIDTH 64
+#define DISPLAY_HEIGHT 32
+// SUPER-CHIP high resolution mode
+#define DISPLAY_HIRES_WIDTH 128
+#define DISPLAY_HIRES_HEIGHT 64
+// Framebuffer size, enough for the largest mode
+#define DISPLAY_WORDS (DISPLAY_HIRES_WIDTH / 64 * DISPLAY_HIRES_HEIGHT)
+
+// The display is stored as 64-bit words, one bit per pixel: pixel x of a
+// row lives in bit 63 - x % 64 of word x / 64 of the row. Rows follow each
+// other, so the low resolution screen is the first 32 words.
+// Every function is specialized on the geometry of the mode at compile
+// time, the hot paths carry no width checks.
+template <unsigned Width, unsigned Height>
+struct DisplayGeometry {
+	static constexpr unsigned width = Width;
+	static constexpr unsigned height = Height;
+	static constexpr unsigned rowWords = Width / 64;
+	static constexpr unsigned words = rowWords * Height;
+	static_assert(Width % 64 == 0 && Height <= 64, "Rows are whole words, dirty rows fit a word");
+};
+
+typedef DisplayGeometry<DISPLAY_WIDTH, DISPLAY_HEIGHT> LowRes;
+typedef DisplayGeometry<DISPLAY_HIRES_WIDTH, DISPLAY_HIRES_HEIGHT> HighRes;
+
+inline uint64_t rotateRight(const uint64_t value, const unsigned shift) {
+	return shift ? value >> shift | value << (64 - shift) : value;
+}
+
+// Bit y set for every row of the geometry
+template <typename G>
+constexpr uint64_t allRows(void) {
+	return G::height == 64 ? ~0ULL : (1ULL << G::height) - 1;
+}
+
+// XORs one sprite row, left aligned in bits, into row `rowIndex` at column x.
+// Pixels past the right edge wrap around, or are dropped with Clip.
+// Returns the pixels that were set before.
+template <typename G, bool Clip = false>
+inline uint64_t blitRow(uint64_t *words, const unsigned rowIndex, const unsigned x, const uint64_t bits) {
+	uint64_t *row = words + rowIndex * G::rowWords;
+	if constexpr (G::rowWords == 1) {
+		uint64_t shifted = Clip ? bits >> x : rotateRight(bits, x);
+		uint64_t collision = *row & shifted;
+		*row ^= shifted;
+		return collision;
+	}
+	else {
+		// The sprite covers at most two neighbouring words, wrapping at the right edge
+		const unsigned word = x / 64;
+		const unsigned shift = x % 64;
+		uint64_t first = bits >> shift;
+		uint64_t second = shift && !(Clip && word + 1 == G::rowWords) ? bits << (64 - shift) : 0;
+		uint64_t &next = row[(word + 1) % G::rowWords];
+		uint64_t collision = (row[word] & first) | (next & second);
+		row[word] ^= first;
+		next ^= second;
+		return collision;
+	}
+}
+
+// XORs an 8 pixel wide sprite into the display, wrapping around the edges.
+// With Clip only the position wraps, the parts past the right and bottom
+// edges are not drawn.
+// Rows that changed are marked in dirtyRows, bit y for row y.
+// Returns true if any set pixel was cleared.
+template <typename G, bool Clip = false>
+inline bool blitSprite(uint64_t *words, uint64_t &dirtyRows, const uint8_t x, const uint8_t y,
+	const uint8_t *sprite, const uint8_t height) {
+	uint64_t collision = 0;
+
+	for (uint8_t line = 0; line < height; line++) {
+		unsigned rowIndex = (y + line) % G::height;
+		if (Clip && y % G::height + line >= G::height) {
+			break;
+		}
+		uint64_t bits = static_cast<uint64_t>(sprite[line]) << 56;
+
+		collision |= blitRow<G, Clip>(words, rowIndex, x % G::width, bits);
+		dirtyRows |= (bits != 0 ? 1ULL : 0ULL) << rowIndex;
+	}
+
+	return collision != 0;
+}
+
+// SUPER-CHIP DXY0: 16x16 sprite of two bytes per row, otherwise like blitSprite
+template <typename G, bool Clip = false>
+inline bool blitSprite16(uint64_t *words, uint64_t &dirtyRows, const uint8_t x, const uint8_t y,
+	const uint8_t *sprite) {
+	uint64_t collision = 0;
+
+	for (unsigned line = 0; line < 16; line++) {
+		unsigned rowIndex = (y + line) % G::height;
+		if (Clip && y % G::height + line >= G::height) {
+			break;
+		}
+		uint64_t bits = static_cast<uint64_t>(sprite[2 * line] << 8 | sprite[2 * line + 1]) << 48;
+
+		collision |= blitRow<G, Clip>(words, rowIndex, x % G::width, bits);
+		dirtyRows |= (bits != 0 ? 1ULL : 0ULL) << rowIndex;
+	}
+
+	return collision != 0;
+}
+
+// Clears the display, marking the rows that were not already blank
+template <typename G>
+inline void clearDisplay(uint64_t *words, uint64_t &dirtyRows) {
+	for (unsigned y = 0; y < G::height; y++) {
+		uint64_t any = 0;
+		for (unsigned w = 0; w < G::rowWords; w++) {
+			any |= words[y * G::rowWords + w];
+			words[y * G::rowWords + w] = 0;
+		}
+		dirtyRows |= (any != 0 ? 1ULL : 0ULL) << y;
+	}
+}
+
+// 00CN: moves the picture down by n rows, blank rows come in at the top
+template <typename G>
+inline void scrollDown(uint64_t *words, uint64_t &dirtyRows, const unsigned n) {
+	for (unsigned y = G::height; y-- > 0;) {
+		for (unsigned w = 0; w < G::rowWords; w++) {
+			words[y * G::rowWords + w] = y >= n ? words[(y - n) * G::rowWords + w] : 0;
+		}
+	}
+	dirtyRows = allRows<G>();
+}
+
+// 00FB: moves the picture right by 4 pixels
+template <typename G>
+inline void scrollRight(uint64_t *words, uint64_t &dirtyRows) {
+	for (unsigned y = 0; y < G::height; y++) {
+		uint64_t *row = words + y * G::rowWords;
+		for (unsigned w = G::rowWords; w-- > 0;) {
+			row[w] = row[w] >> 4 | (w > 0 ? row[w - 1] << 60 : 0);
+		}
+	}
+	dirtyRows = allRows<G>();
+}
+
+// 00FC: moves the picture left by 4 pixels
+template <typename G>
+inline void scrollLeft(uint64_t *words, uint64_t &dirtyRows) {
+	for (unsigned y = 0; y < G::height; y++) {
+		uint64_t *row = words + y * G::rowWords;
+		for (unsigned w = 0; w < G::rowWords; w++) {
+			row[w] = row[w] << 4 | (w + 1 < G::rowWords ? row[w + 1] >> 60 : 0);
+		}
+	}
+	dirtyRows = allRows<G>();
+}
+
+// FNV-1a of the words of a mode, to compare screens
+template <typename G>
+inline uint64_t hashDisplay(const uint64_t *words) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned i = 0; i < G::words; i++) {
+		hash ^= words[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template <typename G>
+inline bool getPixel(const uint64_t *words, const unsigned x, const unsigned y) {
+	return words[y * G::rowWords + x / 64] >> (63 - x % 64) & 1;
+}
\ No newline at end of file
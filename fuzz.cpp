@@ -0,0 +1,155 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "chip8.hpp"
+
+// Fuzzing entry point: every input is a ROM. One machine serves all
+// inputs, it is reset from a snapshot taken right after construction,
+// which costs a few memcpys instead of a constructor, and faults come
+// back from runUntilFault without an exception being thrown.
+//
+// libFuzzer: configure with -DCHIP8_LIBFUZZER=ON (clang) and run
+//   chip8_fuzz corpus_dir
+// AFL++: build with afl-clang-fast++, chip8_fuzz then runs in persistent
+// mode when it gets no arguments:
+//   afl-fuzz -i seeds -o findings -- chip8_fuzz
+// Any build can replay inputs: chip8_fuzz [-r repeat] input...
+//
+// Invalid opcodes end most inputs and are not findings. With
+// CHIP8_FUZZ_ABORT set in the environment, every other fault aborts so the
+// fuzzer keeps the input.
+
+// Instructions per input, and per 60 Hz tick in between
+#define FUZZ_CYCLES 4000
+#define FUZZ_TICK_CYCLES 200
+
+struct FuzzMachine {
+	std::unique_ptr<Chip8> chip8;
+	Snapshot pristine;
+	bool abortOnFault;
+
+	FuzzMachine() : chip8(new Chip8()), abortOnFault(getenv("CHIP8_FUZZ_ABORT") != nullptr) {
+		chip8->setDispatch(Dispatch::Table);
+		chip8->saveState(pristine);
+	}
+};
+
+static FuzzMachine& machine(void) {
+	static FuzzMachine instance;
+	return instance;
+}
+
+// Runs one input, returns its fault
+static Fault runInput(const uint8_t *data, size_t size, uint64_t &executed) {
+	FuzzMachine &m = machine();
+	Chip8 &chip8 = *m.chip8;
+	chip8.loadState(m.pristine);
+	chip8.loadProgram(data, size);
+
+	executed = 0;
+	while (executed < FUZZ_CYCLES) {
+		executed += chip8.runUntilFault(FUZZ_TICK_CYCLES);
+		if (chip8.getFault() != Fault::None) {
+			break;
+		}
+		chip8.tickTimers();
+		// Waiting in FX0A or stopped by 00FD, nobody presses a key
+		if (chip8.isWaitingForKey() || chip8.hasExited()) {
+			break;
+		}
+	}
+
+	const Fault fault = chip8.getFault();
+	if (m.abortOnFault && fault != Fault::None && fault != Fault::InvalidOpcode) {
+		Snapshot state;
+		chip8.saveState(state);
+		fprintf(stderr, "%s at %03X\n", faultName(fault), state.pc);
+		abort();
+	}
+	return fault;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	uint64_t executed;
+	runInput(data, size, executed);
+	return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+__AFL_FUZZ_INIT();
+#endif
+
+static void usage(void) {
+	std::cerr << "usage: chip8_fuzz [-r repeat] input..." << std::endl
+		<< "  -r repeat  run every input this many times and print the rate" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+	if (argc < 2) {
+		machine();
+		__AFL_INIT();
+		const unsigned char *buffer = __AFL_FUZZ_TESTCASE_BUF;
+		uint64_t executed;
+		while (__AFL_LOOP(100000)) {
+			runInput(buffer, __AFL_FUZZ_TESTCASE_LEN, executed);
+		}
+		return 0;
+	}
+#endif
+
+	unsigned long repeat = 1;
+	std::vector<const char*> paths;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+			repeat = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (argv[i][0] == '-') {
+			usage();
+			return 2;
+		}
+		else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.empty() || repeat == 0) {
+		usage();
+		return 2;
+	}
+
+	uint64_t runs = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (const char *path : paths) {
+		std::ifstream in(path, std::ios::binary);
+		if (in.fail()) {
+			std::cerr << "Error: cannot open " << path << std::endl;
+			return 1;
+		}
+		std::vector<uint8_t> input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+		Fault fault = Fault::None;
+		uint64_t executed = 0;
+		for (unsigned long r = 0; r < repeat; r++) {
+			fault = runInput(input.data(), input.size(), executed);
+		}
+		runs += repeat;
+		printf("%s\t%llu cycles\t%s\n", faultName(fault),
+			static_cast<unsigned long long>(executed), path);
+	}
+
+	if (repeat > 1) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("runs: %llu\nruns/sec: %.0f\n", static_cast<unsigned long long>(runs), runs / seconds);
+	}
+	return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "Runner.hpp"
+#include "Scheduler.hpp"
+
+static void usage(void) {
+	std::cerr << "usage: chip8_headless [options] rom_path..." << std::endl
+		<< "  -c cycles    cycle budget per instance (default 1000000)" << std::endl
+		<< "  -d dispatch  interpreter core: switch, table, cached or jit (default table)" << std::endl
+		<< "  -f frames    frame budget per instance, in 60 Hz ticks (0 = unlimited)" << std::endl
+		<< "  -g port      wait for a GDB client on 127.0.0.1:port and run the single ROM" << std::endl
+		<< "               under it, without a budget unless -c or -f is given" << std::endl
+		<< "  -i rate      instructions per second (default 600)" << std::endl
+		<< "  -j threads   worker threads (default: all cores)" << std::endl
+		<< "  -l list      read additional ROM paths from a file, one per line" << std::endl
+		<< "  -m movie     replay an input movie recorded with chip8 --record, checking" << std::endl
+		<< "               its display checkpoints; sets the seed and rate and runs to" << std::endl
+		<< "               the end of the movie unless -c or -f is given" << std::endl
+		<< "  -p format    print an execution profile per instance: text or json" << std::endl
+		<< "               (needs a build with CHIP8_PROFILING)" << std::endl
+		<< "  -q quirks    quirk profile: legacy, vip, schip, xochip, or auto to guess it" << std::endl
+		<< "               per ROM (default legacy)" << std::endl
+		<< "  -r repeat    run every ROM this many times" << std::endl
+		<< "  -s seed      CXNN seed of the first instance, the next ones count up" << std::endl
+		<< "               (default: the fixed default seed)" << std::endl
+		<< "  -t path      record an execution trace, numbered per instance when" << std::endl
+		<< "               there are several (path.0, path.1, ...); see chip8_trace" << std::endl
+		<< "  -v path      capture the screen after every frame, numbered like -t;" << std::endl
+		<< "               path can be a pipe; see chip8_capture" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	Budget budget = { 1000000, 0 };
+	Dispatch dispatch = Dispatch::Table;
+	uint32_t instructionsPerSecond = 600;
+	size_t threads = 0;
+	ProfileFormat profile = ProfileFormat::None;
+	std::string tracePath;
+	std::string capturePath;
+	std::string moviePath;
+	uint16_t debugPort = 0;
+	bool budgetGiven = false;
+	unsigned long repeat = 1;
+	uint64_t seed = RNG_DEFAULT_SEED;
+	QuirkProfile quirks = QuirkProfile::Legacy;
+	bool detectQuirks = false;
+	std::vector<std::string> roms;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(arg, "-c") && hasValue) {
+			budget.cycles = strtoull(argv[++i], nullptr, 10);
+			budgetGiven = true;
+		}
+		else if (!strcmp(arg, "-d") && hasValue) {
+			const char *name = argv[++i];
+			if (!strcmp(name, "switch")) {
+				dispatch = Dispatch::Switch;
+			}
+			else if (!strcmp(name, "table")) {
+				dispatch = Dispatch::Table;
+			}
+			else if (!strcmp(name, "cached")) {
+				dispatch = Dispatch::Cached;
+			}
+			else if (!strcmp(name, "jit")) {
+				dispatch = Dispatch::Jit;
+			}
+			else {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-f") && hasValue) {
+			budget.frames = strtoull(argv[++i], nullptr, 10);
+			budgetGiven = true;
+		}
+		else if (!strcmp(arg, "-g") && hasValue) {
+			debugPort = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+			if (debugPort == 0) {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-i") && hasValue) {
+			instructionsPerSecond = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(arg, "-j") && hasValue) {
+			threads = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(arg, "-q") && hasValue) {
+			const char *name = argv[++i];
+			detectQuirks = !strcmp(name, "auto");
+			if (!detectQuirks && !parseQuirkProfile(name, quirks)) {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-r") && hasValue) {
+			repeat = strtoul(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(arg, "-s") && hasValue) {
+			seed = strtoull(argv[++i], nullptr, 0);
+		}
+		else if (!strcmp(arg, "-p") && hasValue) {
+			const char *name = argv[++i];
+			if (!strcmp(name, "text")) {
+				profile = ProfileFormat::Text;
+			}
+			else if (!strcmp(name, "json")) {
+				profile = ProfileFormat::Json;
+			}
+			else {
+				usage();
+				return 2;
+			}
+#ifndef CHIP8_PROFILING
+			std::cerr << "Error: profiling is not compiled in, rebuild with CHIP8_PROFILING" << std::endl;
+			return 2;
+#endif
+		}
+		else if (!strcmp(arg, "-m") && hasValue) {
+			moviePath = argv[++i];
+		}
+		else if (!strcmp(arg, "-t") && hasValue) {
+			tracePath = argv[++i];
+		}
+		else if (!strcmp(arg, "-v") && hasValue) {
+			capturePath = argv[++i];
+		}
+		else if (!strcmp(arg, "-l") && hasValue) {
+			std::ifstream list(argv[++i]);
+			if (list.fail()) {
+				std::cerr << "Error: cannot open " << argv[i] << std::endl;
+				return 2;
+			}
+			std::string line;
+			while (std::getline(list, line)) {
+				if (!line.empty()) {
+					roms.push_back(line);
+				}
+			}
+		}
+		else if (arg[0] == '-') {
+			usage();
+			return 2;
+		}
+		else {
+			roms.push_back(arg);
+		}
+	}
+
+	if ((!moviePath.empty() || debugPort) && !budgetGiven) {
+		budget = { 0, 0 };
+	}
+	if (debugPort && (roms.size() != 1 || repeat != 1)) {
+		std::cerr << "Error: -g debugs a single ROM" << std::endl;
+		return 2;
+	}
+	if (roms.empty() || (budget.cycles == 0 && budget.frames == 0 && moviePath.empty() && !debugPort)
+		|| instructionsPerSecond < TIMER_HZ) {
+		usage();
+		return 2;
+	}
+
+	std::vector<Job> jobs;
+	for (unsigned long r = 0; r < repeat; r++) {
+		for (auto &rom : roms) {
+			jobs.push_back({ rom, budget, dispatch, instructionsPerSecond, profile, "", seed + jobs.size(), moviePath,
+				quirks, detectQuirks, "", debugPort });
+		}
+	}
+	for (size_t i = 0; i < jobs.size() && !tracePath.empty(); i++) {
+		jobs[i].tracePath = jobs.size() > 1 ? tracePath + "." + std::to_string(i) : tracePath;
+	}
+	for (size_t i = 0; i < jobs.size() && !capturePath.empty(); i++) {
+		jobs[i].capturePath = jobs.size() > 1 ? capturePath + "." + std::to_string(i) : capturePath;
+	}
+
+	Runner runner(threads);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<JobResult> results = runner.run(jobs);
+	uint64_t wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	Runner::printSummary(std::cout, results, wallNs);
+
+	for (auto &result : results) {
+		if (profile == ProfileFormat::Json) {
+			std::cout << "{\"rom\": \"" << result.romPath << "\", \"profile\": " << result.profile << "}" << std::endl;
+		}
+		else if (profile == ProfileFormat::Text) {
+			std::cout << std::endl << "profile of " << result.romPath << ":" << std::endl << result.profile;
+		}
+	}
+
+	for (auto &result : results) {
+		if (result.status == JobStatus::LoadError || result.status == JobStatus::InvalidOpcode
+			|| result.status == JobStatus::Desync) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -1,42 +1,129 @@
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <thread>
 #include "chip8.hpp"
+#include "Beeper.hpp"
+#include "Emulator.hpp"
+#include "LiveStats.hpp"
+#include "Movie.hpp"
 #include "OpcodeException.hpp"
+#include "Overlay.hpp"
+#include "Profiler.hpp"
+#include "Rom.hpp"
+#include "Renderer.hpp"
+#include "Scheduler.hpp"
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 
 #define RES_MULT 20
-#define WIDTH 64
-#define HEIGHT 32
-#define PIXELS WIDTH * HEIGHT
 
 void displayError(sf::RenderWindow &window, const std::string errorText, const uint8_t errorCode);
-void playSound(void *sound);
+int8_t chip8Key(const sf::Keyboard::Key code);
 
 
 int main(int argc, char* argv[]) {
-	// Randomize random number generator for use at opcode 0xC000
-	srand(static_cast<unsigned int>(time(nullptr)));
-
-	sf::RenderWindow window(sf::VideoMode(64 * RES_MULT, 32 * RES_MULT), "Chip8 Emulator", sf::Style::Titlebar | sf::Style::Close);
-	
-	// Using pointer so it can later be ckecked if sound loaded successfully
-	// withoud the need of additional code
-	sf::SoundBuffer *soundBuffer = new sf::SoundBuffer();
-	sf::Sound *sound = new sf::Sound();
-	if (!(argc > 2 && soundBuffer->loadFromFile(argv[2]))) {
-		delete soundBuffer;
-		delete sound;
-		sound = NULL;
+	// The positional argument is the ROM, options start with --
+	std::vector<const char*> args;
+	const char *tracePath = nullptr;
+	const char *moviePath = nullptr;
+	uint32_t instructionsPerSecond = 600;
+	// A fresh CXNN sequence every run unless one is asked for
+	uint64_t seed = static_cast<uint64_t>(time(nullptr));
+	ClockMode clockMode = ClockMode::RealTime;
+	// Guessed from the ROM unless one is asked for
+	const char *quirksName = "auto";
+	// Printed once the window is closed
+	ProfileFormat latencyFormat = ProfileFormat::None;
+	// Rewritten with the live stats every second
+	const char *metricsPath = nullptr;
+	const char *fontPath = nullptr;
+	bool showStats = false;
+#ifdef CHIP8_PROFILING
+	ProfileFormat profile = ProfileFormat::None;
+#endif
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "--rate=", 7)) {
+			instructionsPerSecond = strtoul(argv[i] + 7, nullptr, 10);
+		}
+		else if (!strncmp(argv[i], "--seed=", 7)) {
+			seed = strtoull(argv[i] + 7, nullptr, 0);
+		}
+		else if (!strcmp(argv[i], "--warp")) {
+			clockMode = ClockMode::Warp;
+		}
+		else if (!strncmp(argv[i], "--trace=", 8)) {
+			tracePath = argv[i] + 8;
+		}
+		else if (!strncmp(argv[i], "--quirks=", 9)) {
+			quirksName = argv[i] + 9;
+		}
+		else if (!strncmp(argv[i], "--record=", 9)) {
+			moviePath = argv[i] + 9;
+		}
+		else if (!strcmp(argv[i], "--latency")) {
+			latencyFormat = ProfileFormat::Text;
+		}
+		else if (!strcmp(argv[i], "--latency=json")) {
+			latencyFormat = ProfileFormat::Json;
+		}
+		else if (!strncmp(argv[i], "--metrics=", 10)) {
+			metricsPath = argv[i] + 10;
+		}
+		else if (!strcmp(argv[i], "--stats")) {
+			showStats = true;
+		}
+		else if (!strncmp(argv[i], "--font=", 7)) {
+			fontPath = argv[i] + 7;
+		}
+#ifdef CHIP8_PROFILING
+		else if (!strcmp(argv[i], "--profile")) {
+			profile = ProfileFormat::Text;
+		}
+		else if (!strcmp(argv[i], "--profile=json")) {
+			profile = ProfileFormat::Json;
+		}
+#endif
+		else {
+			args.push_back(argv[i]);
+		}
 	}
-	else {
-		sound->setBuffer(*soundBuffer);
+	QuirkProfile quirks = QuirkProfile::Legacy;
+	if (args.empty() || (strcmp(quirksName, "auto") && !parseQuirkProfile(quirksName, quirks))) {
+		std::cerr << "usage: chip8 game_rom_path [--rate=instructions_per_second] [--seed=n] [--quirks=legacy|vip|schip|xochip|auto] [--warp] [--trace=file] [--record=movie] [--latency[=json]] [--metrics=file] [--stats] [--font=file] [--profile[=json]]" << std::endl;
+		return 1;
 	}
 
+	sf::RenderWindow window(sf::VideoMode(DISPLAY_WIDTH * RES_MULT, DISPLAY_HEIGHT * RES_MULT), "Chip8 Emulator", sf::Style::Titlebar | sf::Style::Close);
+	
+	// Synthesized on SFML's audio thread from the edges the core publishes
+	Beeper beeper(instructionsPerSecond);
+
 	Chip8 chip8;
+	// Replayed with chip8_headless -m
+	Movie movie;
 	try {
-		chip8.loadROM(argv[1]);
-		chip8.setSound(playSound, (void *) sound);
+		// The table handlers are instantiated per quirk profile, the switch decoder checks it on every instruction
+		chip8.setDispatch(Dispatch::Table);
+		chip8.setSeed(seed);
+		chip8.loadROM(args[0]);
+		if (!strcmp(quirksName, "auto")) {
+			quirks = RomStore::shared().load(args[0])->detectQuirks();
+		}
+		chip8.setQuirks(quirks);
+		chip8.setSoundQueue(&beeper.getQueue());
+		if (tracePath) {
+			chip8.startTrace(tracePath);
+		}
+		if (moviePath) {
+			movie.begin(args[0], seed, instructionsPerSecond, quirks);
+		}
+#ifdef CHIP8_PROFILING
+		chip8.setProfiling(profile != ProfileFormat::None);
+#endif
 	}
 	catch (const std::runtime_error & error) {
 		displayError(window, "File error", 3);
@@ -44,91 +131,140 @@ int main(int argc, char* argv[]) {
 
 	sf::Color pixelOff(sf::Color::Black);
 	sf::Color pixelOn(sf::Color::White);
+	Renderer renderer(RES_MULT, pixelOn, pixelOff);
+	// Presentation is paced by the monitor, emulation by its own thread
+	window.setVerticalSyncEnabled(true);
+	Emulator emulator(chip8, instructionsPerSecond, clockMode, moviePath ? &movie : nullptr);
+	beeper.play();
+	emulator.start();
+	LatencyStats latency;
+	// F3 shows and hides the stats
+	LiveStats liveStats;
+	Overlay overlay;
+	if (!overlay.loadFont(fontPath) && (showStats || fontPath)) {
+		std::cerr << "Error: no font for the stats overlay, pass one with --font" << std::endl;
+	}
+	overlay.setVisible(showStats);
+	// When the window thread last found the event queue empty
+	uint64_t lastPoll = steadyNs();
 	sf::Event event;
 	// As long the window is not closed
 	while (window.isOpen()) {
+		bool redraw = false;
 		// and there is an event in the event queue
 		/// if there's no pending event then it will return false and leave event unmodified
 		while (window.pollEvent(event)) {
+			const uint64_t polled = steadyNs();
 			switch (event.type) {
 				case sf::Event::Closed: window.close(); break;
 				case sf::Event::KeyPressed: {
+					int8_t key = chip8Key(event.key.code);
+					if (key >= 0) {
+						emulator.post({ InputKind::KeyDown, static_cast<uint8_t>(key), lastPoll, polled });
+					}
+					// Backspace rewinds while held, F5/F9 keep one quick save
 					switch (event.key.code) {
-					case sf::Keyboard::Num1: chip8.keyPress(0x1); break;
-					case sf::Keyboard::Num2: chip8.keyPress(0x2); break;
-					case sf::Keyboard::Num3: chip8.keyPress(0x3); break;
-					case sf::Keyboard::Num4: chip8.keyPress(0xc); break;
-					case sf::Keyboard::Q: chip8.keyPress(0x4); break;
-					case sf::Keyboard::W: chip8.keyPress(0x5); break;
-					case sf::Keyboard::E: chip8.keyPress(0x6); break;
-					case sf::Keyboard::R: chip8.keyPress(0xd); break;
-					case sf::Keyboard::A: chip8.keyPress(0x7); break;
-					case sf::Keyboard::S: chip8.keyPress(0x8); break;
-					case sf::Keyboard::D: chip8.keyPress(0x9); break;
-					case sf::Keyboard::F: chip8.keyPress(0xe); break;
-					case sf::Keyboard::Z: chip8.keyPress(0xa); break;
-					case sf::Keyboard::X: chip8.keyPress(0x0); break;
-					case sf::Keyboard::C: chip8.keyPress(0xb); break;
-					case sf::Keyboard::V: chip8.keyPress(0xf); break;
+					case sf::Keyboard::BackSpace: emulator.post({ InputKind::RewindStart, 0, lastPoll, polled }); break;
+					case sf::Keyboard::F5: emulator.post({ InputKind::QuickSave, 0, lastPoll, polled }); break;
+					case sf::Keyboard::F9: emulator.post({ InputKind::QuickLoad, 0, lastPoll, polled }); break;
+					case sf::Keyboard::F3: overlay.setVisible(!overlay.isVisible()); redraw = true; break;
+					default: break;
 					}
 					break;
 				}
 				case sf::Event::KeyReleased: {
-					switch (event.key.code) {
-					case sf::Keyboard::Num1: chip8.keyRelease(0x1); break;
-					case sf::Keyboard::Num2: chip8.keyRelease(0x2); break;
-					case sf::Keyboard::Num3: chip8.keyRelease(0x3); break;
-					case sf::Keyboard::Num4: chip8.keyRelease(0xc); break;
-					case sf::Keyboard::Q: chip8.keyRelease(0x4); break;
-					case sf::Keyboard::W: chip8.keyRelease(0x5); break;
-					case sf::Keyboard::E: chip8.keyRelease(0x6); break;
-					case sf::Keyboard::R: chip8.keyRelease(0xd); break;
-					case sf::Keyboard::A: chip8.keyRelease(0x7); break;
-					case sf::Keyboard::S: chip8.keyRelease(0x8); break;
-					case sf::Keyboard::D: chip8.keyRelease(0x9); break;
-					case sf::Keyboard::F: chip8.keyRelease(0xe); break;
-					case sf::Keyboard::Z: chip8.keyRelease(0xa); break;
-					case sf::Keyboard::X: chip8.keyRelease(0x0); break;
-					case sf::Keyboard::C: chip8.keyRelease(0xb); break;
-					case sf::Keyboard::V: chip8.keyRelease(0xf); break;
+					int8_t key = chip8Key(event.key.code);
+					if (key >= 0) {
+						emulator.post({ InputKind::KeyUp, static_cast<uint8_t>(key), lastPoll, polled });
+					}
+					if (event.key.code == sf::Keyboard::BackSpace) {
+						emulator.post({ InputKind::RewindStop, 0, lastPoll, polled });
 					}
 					break;
 				}
+				default: break;
 			}
 		}
-		// If there is no other event in queue
+		lastPoll = steadyNs();
 
-		try {
-			chip8.emulateCycle();
-		}
-		catch (OpCodeException e) {
-			std::cerr << e.getMessage() << std::endl << "opcode: " << e.getOpCode() << std::endl << "Memory offset: " << e.getOffset() << std::endl;
+		if (emulator.hasFailed()) {
+			OpCodeException *e = emulator.getFault();
+			std::cerr << e->getMessage() << std::endl << "opcode: " << e->getOpCode() << std::endl << "Memory offset: " << e->getOffset() << std::endl;
+			// displayError exits, the trace and the movie have to be completed first
+			emulator.stop();
+			chip8.stopTrace();
+			if (moviePath) {
+				try {
+					movie.save(moviePath);
+				}
+				catch (const std::runtime_error &error) {
+					std::cerr << error.what() << std::endl;
+				}
+			}
 
 			window.clear();
 			displayError(window, "Exception", 5);
 		}
 
-		// Refresh screen only if changes is pixels occured
-		if (chip8.getDrawFlag()) {
-			sf::RectangleShape pixel;
-			uint16_t i = 0;
-			window.clear();
-			for (auto memPixel : chip8.getPixels()) {
-				pixel.setFillColor(memPixel ? pixelOn : pixelOff);
-				pixel.setPosition(i % WIDTH * RES_MULT, i / WIDTH * RES_MULT);
-				pixel.setSize(sf::Vector2f(RES_MULT, RES_MULT));
-				// Draw primitives defined by a vertex buffer
-				window.draw(pixel);
-				i++;
+		// Sampled once per interval, a visible overlay is redrawn with it
+		if (liveStats.isDue(lastPoll)) {
+			liveStats.sample(emulator.takeStats(), lastPoll);
+			overlay.setText(liveStats.summary());
+			redraw = redraw || overlay.isVisible();
+			if (metricsPath) {
+				try {
+					liveStats.dump(metricsPath, args[0]);
+				}
+				catch (const std::runtime_error &error) {
+					// Reported once, the session goes on without the dump
+					std::cerr << error.what() << std::endl;
+					metricsPath = nullptr;
+				}
 			}
+		}
 
+		// Only the newest frame is presented, rows untouched since the
+		// last one are not uploaded again
+		const Frame *frame = emulator.takeFrame();
+		const bool changed = frame && renderer.update(frame->display, frame->dirtyRows, frame->highRes);
+		if (changed || redraw) {
+			window.clear();
+			renderer.draw(window);
+			overlay.draw(window);
 			// Display on screen what has been rendered to the window so far
 			window.display();
-			chip8.setDrawFlag(true);
+			const uint64_t presented = steadyNs();
+			liveStats.present(presented);
+			if (changed && frame->latency.polled) {
+				latency.record(frame->latency, presented);
+			}
+		}
+		else {
+			// Nothing new, do not spin while the guest is between frames
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
 	}
 
-	delete sound;
+	emulator.stop();
+	beeper.stop();
+	latency.write(std::cout, latencyFormat, args[0], emulator.getPresses());
+
+	if (moviePath) {
+		try {
+			movie.save(moviePath);
+		}
+		catch (const std::runtime_error &error) {
+			std::cerr << error.what() << std::endl;
+			return 1;
+		}
+	}
+
+#ifdef CHIP8_PROFILING
+	// Printed once the window is closed
+	if (chip8.getProfiler()) {
+		chip8.getProfiler()->write(std::cout, profile);
+	}
+#endif
 	
 	return 0;
 }
@@ -149,16 +285,25 @@ void displayError(sf::RenderWindow &window, const std::string errorText, const u
 	exit(errorCode);
 }
 
-void playSound(void *sound) {
-	// Emulator class will not be dependent from a certain library
-	// thus we use a void pointer and typecast it to our library
-	sf::Sound *playSound;
-	if (sound) {
-		playSound = (sf::Sound*) sound;
-		playSound->play();
-	}
-	else {
-		// Play system sound
-		fprintf(stdout, "%c", 7);
+// Keypad key of a host key, -1 for keys that are not mapped
+int8_t chip8Key(const sf::Keyboard::Key code) {
+	switch (code) {
+	case sf::Keyboard::Num1: return 0x1;
+	case sf::Keyboard::Num2: return 0x2;
+	case sf::Keyboard::Num3: return 0x3;
+	case sf::Keyboard::Num4: return 0xc;
+	case sf::Keyboard::Q: return 0x4;
+	case sf::Keyboard::W: return 0x5;
+	case sf::Keyboard::E: return 0x6;
+	case sf::Keyboard::R: return 0xd;
+	case sf::Keyboard::A: return 0x7;
+	case sf::Keyboard::S: return 0x8;
+	case sf::Keyboard::D: return 0x9;
+	case sf::Keyboard::F: return 0xe;
+	case sf::Keyboard::Z: return 0xa;
+	case sf::Keyboard::X: return 0x0;
+	case sf::Keyboard::C: return 0xb;
+	case sf::Keyboard::V: return 0xf;
+	default: return -1;
 	}
 }
\ No newline at end of file
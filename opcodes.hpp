@@ -0,0 +1,152 @@
+#pragma once
+#include <cstdint>
+
+class Chip8;
+
+// Instruction classes, in the order they appear in Chip8::decodeOpCode
+enum class OpClass : uint8_t {
+	ScrollDown, // 00CN, SUPER-CHIP
+	Cls,        // 00E0
+	Ret,        // 00EE
+	ScrollRight, // 00FB, SUPER-CHIP
+	ScrollLeft, // 00FC, SUPER-CHIP
+	Exit,       // 00FD, SUPER-CHIP
+	LowRes,     // 00FE, SUPER-CHIP
+	HighRes,    // 00FF, SUPER-CHIP
+	Jump,       // 1NNN
+	Call,       // 2NNN
+	SkipEqImm,  // 3XNN
+	SkipNeImm,  // 4XNN
+	SkipEqReg,  // 5XY0
+	LoadImm,    // 6XNN
+	AddImm,     // 7XNN
+	Move,       // 8XY0
+	Or,         // 8XY1
+	And,        // 8XY2
+	Xor,        // 8XY3
+	AddReg,     // 8XY4
+	SubReg,     // 8XY5
+	ShiftRight, // 8XY6
+	SubNeg,     // 8XY7
+	ShiftLeft,  // 8XYE
+	SkipNeReg,  // 9XY0
+	LoadI,      // ANNN
+	JumpV0,     // BNNN
+	Random,     // CXNN
+	Draw,       // DXYN
+	Draw16,     // DXY0, SUPER-CHIP
+	SkipKey,    // EX9E
+	SkipNoKey,  // EXA1
+	GetDelay,   // FX07
+	WaitKey,    // FX0A
+	SetDelay,   // FX15
+	SetSound,   // FX18
+	AddI,       // FX1E
+	Font,       // FX29
+	BigFont,    // FX30, SUPER-CHIP
+	Bcd,        // FX33
+	Store,      // FX55
+	Load,       // FX65
+	SaveFlags,  // FX75, SUPER-CHIP
+	LoadFlags,  // FX85, SUPER-CHIP
+	Invalid,
+	Count
+};
+
+// Opcode pre-decoded into its handler and operand fields
+struct Instruction {
+	bool (*execute)(Chip8 &chip8, const Instruction &instr);
+	uint16_t nnn;
+	uint8_t x;
+	uint8_t y;
+	uint8_t nn;
+	uint8_t n;
+};
+
+// Classifies an opcode exactly as Chip8::decodeOpCode accepts it
+inline OpClass classifyOpCode(const uint16_t opcode) {
+	switch (opcode >> 12) {
+		case 0x0: {
+			if ((opcode & 0xFFF0) == 0x00C0) {
+				return OpClass::ScrollDown;
+			}
+			switch (opcode & 0x0FF) {
+				case 0xE0: return OpClass::Cls;
+				case 0xEE: return OpClass::Ret;
+				default: break;
+			}
+			// The SUPER-CHIP ones are whole words, other 0NNN are machine code calls
+			switch (opcode) {
+				case 0x00FB: return OpClass::ScrollRight;
+				case 0x00FC: return OpClass::ScrollLeft;
+				case 0x00FD: return OpClass::Exit;
+				case 0x00FE: return OpClass::LowRes;
+				case 0x00FF: return OpClass::HighRes;
+				default: return OpClass::Invalid;
+			}
+		}
+		case 0x1: return OpClass::Jump;
+		case 0x2: return OpClass::Call;
+		case 0x3: return OpClass::SkipEqImm;
+		case 0x4: return OpClass::SkipNeImm;
+		case 0x5: return OpClass::SkipEqReg;
+		case 0x6: return OpClass::LoadImm;
+		case 0x7: return OpClass::AddImm;
+		case 0x8: {
+			switch (opcode & 0x0F) {
+				case 0x0: return OpClass::Move;
+				case 0x1: return OpClass::Or;
+				case 0x2: return OpClass::And;
+				case 0x3: return OpClass::Xor;
+				case 0x4: return OpClass::AddReg;
+				case 0x5: return OpClass::SubReg;
+				case 0x6: return OpClass::ShiftRight;
+				case 0x7: return OpClass::SubNeg;
+				case 0xE: return OpClass::ShiftLeft;
+				default: return OpClass::Invalid;
+			}
+		}
+		case 0x9: return OpClass::SkipNeReg;
+		case 0xA: return OpClass::LoadI;
+		case 0xB: return OpClass::JumpV0;
+		case 0xC: return OpClass::Random;
+		case 0xD: return (opcode & 0x0F) ? OpClass::Draw : OpClass::Draw16;
+		case 0xE: {
+			switch (opcode & 0x0FF) {
+				case 0x9E: return OpClass::SkipKey;
+				case 0xA1: return OpClass::SkipNoKey;
+				default: return OpClass::Invalid;
+			}
+		}
+		default: {
+			switch (opcode & 0x0FF) {
+				case 0x07: return OpClass::GetDelay;
+				case 0x0A: return OpClass::WaitKey;
+				case 0x15: return OpClass::SetDelay;
+				case 0x18: return OpClass::SetSound;
+				case 0x1E: return OpClass::AddI;
+				case 0x29: return OpClass::Font;
+				case 0x30: return OpClass::BigFont;
+				case 0x33: return OpClass::Bcd;
+				case 0x55: return OpClass::Store;
+				case 0x65: return OpClass::Load;
+				case 0x75: return OpClass::SaveFlags;
+				case 0x85: return OpClass::LoadFlags;
+				default: return OpClass::Invalid;
+			}
+		}
+	}
+}
+
+// Opcode pattern of a class, e.g. "8XY4"
+inline const char* opClassName(const OpClass opClass) {
+	static const char *names[] = {
+		"00CN", "00E0", "00EE", "00FB", "00FC", "00FD", "00FE", "00FF", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+		"8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+		"9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "DXY0", "EX9E", "EXA1",
+		"FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX30", "FX33", "FX55", "FX65",
+		"FX75", "FX85",
+		"invalid"
+	};
+	return names[static_cast<int>(opClass)];
+}
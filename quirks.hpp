@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Interpreters that CHIP-8 programs were written for, they disagree on a
+// few instructions. Legacy is what this emulator always did.
+enum class QuirkProfile : uint8_t {
+	Legacy,
+	CosmacVip, // The original interpreter of the COSMAC VIP
+	Schip,     // SUPER-CHIP 1.1 on the HP 48
+	XoChip,    // Octo
+	Count
+};
+
+// Behaviour of the instructions that differ between profiles
+struct Quirks {
+	bool shiftUsesVY;          // 8XY6/8XYE shift VY into VX, otherwise VX in place
+	bool loadStoreIncrementsI; // FX55/FX65 leave I past the last register
+	bool jumpUsesVX;           // BNNN jumps to XNN + VX instead of NNN + V0
+	bool logicResetsVF;        // 8XY1/8XY2/8XY3 clear VF
+	bool addISetsVF;           // FX1E sets VF when I passes 0xFFF
+	bool clipSprites;          // Sprites are cut at the screen edges instead of wrapping
+};
+
+// Usable as a template argument, every handler of the table dispatcher is
+// instantiated per profile and carries no quirk branches
+constexpr Quirks quirksOf(const QuirkProfile profile) {
+	switch (profile) {
+		case QuirkProfile::CosmacVip: return { true, true, false, true, false, true };
+		case QuirkProfile::Schip: return { false, false, true, false, false, true };
+		case QuirkProfile::XoChip: return { true, true, false, false, false, false };
+		default: return { false, false, false, false, true, false };
+	}
+}
+
+inline const char* quirkProfileName(const QuirkProfile profile) {
+	static const char *names[] = { "legacy", "vip", "schip", "xochip" };
+	return profile < QuirkProfile::Count ? names[static_cast<int>(profile)] : "unknown";
+}
+
+// Returns false for names quirkProfileName does not produce
+inline bool parseQuirkProfile(const char *name, QuirkProfile &profile) {
+	for (uint8_t i = 0; i < static_cast<uint8_t>(QuirkProfile::Count); i++) {
+		if (!strcmp(name, quirkProfileName(static_cast<QuirkProfile>(i)))) {
+			profile = static_cast<QuirkProfile>(i);
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
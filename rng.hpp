@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 (XSH RR) generator for CXNN, one per machine.
+// Its whole state is a single word, so it is cheap to copy into snapshots,
+// and a machine's random numbers depend only on its seed.
+
+#define RNG_DEFAULT_SEED 0x853C49E6748FEA9BULL
+#define RNG_MULTIPLIER 6364136223846793005ULL
+#define RNG_INCREMENT 1442695040888963407ULL
+
+inline uint32_t rngNext(uint64_t &state) {
+	uint64_t old = state;
+	state = old * RNG_MULTIPLIER + RNG_INCREMENT;
+
+	uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+	uint32_t rotation = static_cast<uint32_t>(old >> 59);
+	return xorShifted >> rotation | xorShifted << ((32 - rotation) & 31);
+}
+
+// Initial state for a seed
+inline uint64_t rngSeed(const uint64_t seed) {
+	uint64_t state = 0;
+	rngNext(state);
+	state += seed;
+	rngNext(state);
+	return state;
+}
+
+// Random byte of CXNN, the best bits of the output
+inline uint8_t rngByte(uint64_t &state) {
+	return static_cast<uint8_t>(rngNext(state) >> 24);
+}
\ No newline at end of file
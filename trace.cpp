@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "opcodes.hpp"
+#include "Trace.hpp"
+
+// Decodes execution traces written by Chip8::startTrace
+
+static void usage(void) {
+	std::cerr << "usage: chip8_trace [options] trace_file" << std::endl
+		<< "  -c first[-last]  cycle or cycle range" << std::endl
+		<< "  -p first[-last]  address or address range, in hex" << std::endl
+		<< "  -o class         opcode class, e.g. 8XY4 or DXYN" << std::endl
+		<< "  -r register      instructions that changed Vx, in hex" << std::endl
+		<< "  -n count         stop after printing this many records" << std::endl
+		<< "  -s               only print the number of matching records" << std::endl;
+}
+
+// Parses "first" or "first-last"
+static bool parseRange(const char *text, int base, uint64_t &first, uint64_t &last) {
+	char *end;
+	first = strtoull(text, &end, base);
+	if (end == text) {
+		return false;
+	}
+	last = first;
+	if (*end == '-') {
+		const char *start = end + 1;
+		last = strtoull(start, &end, base);
+		if (end == start) {
+			return false;
+		}
+	}
+	return *end == '\0' && first <= last;
+}
+
+int main(int argc, char* argv[]) {
+	uint64_t firstCycle = 0, lastCycle = UINT64_MAX;
+	uint64_t firstPc = 0, lastPc = 0xFFFF;
+	int opClass = -1;
+	uint16_t registerMask = 0xFFFF;
+	uint64_t limit = UINT64_MAX;
+	bool countOnly = false;
+	const char *path = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(arg, "-c") && hasValue) {
+			if (!parseRange(argv[++i], 10, firstCycle, lastCycle)) {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-p") && hasValue) {
+			if (!parseRange(argv[++i], 16, firstPc, lastPc)) {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-o") && hasValue) {
+			std::string name = argv[++i];
+			for (auto &ch : name) {
+				ch = static_cast<char>(toupper(ch));
+			}
+			for (int c = 0; c < static_cast<int>(OpClass::Count); c++) {
+				if (name == opClassName(static_cast<OpClass>(c))) {
+					opClass = c;
+				}
+			}
+			if (opClass < 0) {
+				usage();
+				return 2;
+			}
+		}
+		else if (!strcmp(arg, "-r") && hasValue) {
+			registerMask = 1 << (strtoul(argv[++i], nullptr, 16) & 0xF);
+		}
+		else if (!strcmp(arg, "-n") && hasValue) {
+			limit = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (!strcmp(arg, "-s")) {
+			countOnly = true;
+		}
+		else if (arg[0] == '-' || path) {
+			usage();
+			return 2;
+		}
+		else {
+			path = arg;
+		}
+	}
+	if (!path) {
+		usage();
+		return 2;
+	}
+
+	std::ifstream in(path, std::ios::binary);
+	TraceHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.magic != TRACE_MAGIC || header.version != TRACE_VERSION
+		|| header.recordSize != sizeof(TraceRecord)) {
+		std::cerr << "Error: " << path << " is not a trace file" << std::endl;
+		return 1;
+	}
+
+	bool anyRegister = registerMask == 0xFFFF;
+	std::vector<TraceRecord> buffer(4096);
+	uint64_t remaining = header.records;
+	uint64_t matched = 0;
+
+	while (remaining > 0 && matched < limit) {
+		size_t count = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+		if (!in.read(reinterpret_cast<char*>(buffer.data()), count * sizeof(TraceRecord))) {
+			std::cerr << "Error: " << path << " is truncated" << std::endl;
+			return 1;
+		}
+		remaining -= count;
+
+		for (size_t i = 0; i < count && matched < limit; i++) {
+			const TraceRecord &record = buffer[i];
+			if (record.cycle < firstCycle || record.cycle > lastCycle
+				|| record.pc < firstPc || record.pc > lastPc
+				|| (opClass >= 0 && static_cast<int>(classifyOpCode(record.opcode)) != opClass)
+				|| (!anyRegister && !(record.changed & registerMask))) {
+				continue;
+			}
+			matched++;
+			if (countOnly) {
+				continue;
+			}
+
+			printf("%12llu  %03X  %04X  %-7s I=%03X ", static_cast<unsigned long long>(record.cycle),
+				record.pc, record.opcode, opClassName(classifyOpCode(record.opcode)), record.I);
+			for (int x = 0; x < 16; x++) {
+				if (record.changed & 1 << x) {
+					printf(" V%X=%02X", x, record.V[x]);
+				}
+			}
+			printf("\n");
+		}
+
+		// Records are in cycle order
+		if (header.records > 0 && buffer[count - 1].cycle > lastCycle) {
+			break;
+		}
+	}
+
+	if (countOnly) {
+		printf("%llu\n", static_cast<unsigned long long>(matched));
+	}
+	return 0;
+}
\ No newline at end of file